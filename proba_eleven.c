@@ -8,16 +8,66 @@
 
 	Compilation : use any ansi c compiler
 
-#compil# gcc -std=c99 -W -Wall -Werror -Wextra -pedantic -o a.exe THIS_FILE &&
+#compil# gcc -std=c99 -W -Wall -Werror -Wextra -pedantic -O2 -pthread -o a.exe THIS_FILE -lm &&
 #compil# echo compil ok 1>&2 &&
 #compil# time a.exe > a.txt
 
+	With -mavx2 (or -march=native), the ceremonies are tested on 4 arrangements at once.
+
+	Use : a.exe [options] [EVENT_LOG | -]
+	reads the season from the event log (see run_event_log()), or from the standard input with -,
+	or without event log, runs the test chosen in main().
+
+	Options :
+		--bench      to run the benchmarks (see run_bench()), with the options before it
+		--threads N  to review the arrangements with N threads (default 1)
+		--budget S   the time in seconds of the search of a lineup, or of the sampling (default 2, see search_lineup())
+		--stats F    to write the timings and counts of each review and print in the file F, or on stderr with - (see stats_record())
+		--progress   to show the progress of the long reviews on stderr
+		--all        to print the probabilities after each event (and not only at print and at the end)
+		--backtrack  to count by backtracking (see count_backtrack()) instead of reviewing all arrangements
+		--dp         to count by dynamic programming (see count_dp()), the fastest for n = 11 to 13
+		--sample     to estimate by Monte Carlo (see sample_proba()), for the seasons too big to count
+		--precision P the standard error in % where the sampling stops (default 0.5)
+		--snapshot F to save the state in the file F after the events, and to resume from F if it exists
+		--spill D    to keep the arrangements on disk in the directory D, by compressed chunks (see struct spill), for n = 12 or 13
+		--scenario F to review the event log F with the other ones given with --scenario, in one sweep (see run_scenarios())
+		--shard I/N  to review only the shard I of N of the arrangements of the event log (see run_shard())
+		--out F      the shard file where --shard writes its counts
+		--merge F... to add the counts of all the shard files F..., and print the probabilities (the last option)
+		--serve      to keep the season in memory, and answer the commands of the standard input (see serve_commands())
+		--socket P   the same, with the commands of the connections to the local socket P
+
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <setjmp.h>
+#include <signal.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #define MAX_NAME 10 /* Max size (number of letters) of names */
+#define MAX_N 16 /* Max number of positions (an arrangement is packed with 4 bits per position) */
+#define MAX_REVIEW (1LL << 32) /* Max number of arrangements reviewed one by one (the bitset takes n_arr / 8 bytes : 512 MB) */
+#define SURV_RATIO 64 /* Possible arrangements are kept in a list once they are less than n_arr / SURV_RATIO (the list is then smaller than the bitset) */
+#define SPILL_LIST (1LL << 24) /* With --spill, they are kept in a list once they are less than this (128 MB) */
 #define YES 1 /* Boolean */
 #define NO  0 /* Boolean */
 
@@ -32,6 +82,28 @@ int* new_array(int n)
 	return array;
 }
 
+/* Memory allocation of n packed arrangements */
+uint64_t* new_codes(long long n)
+{
+	uint64_t* codes = (uint64_t*)malloc((n > 0 ? (size_t)n : 1) * sizeof(uint64_t));
+	if(!codes) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	return codes;
+}
+
+/* Memory allocation of n counters, all 0 */
+long long* new_counts(long long n)
+{
+	long long* counts = (long long*)calloc(n > 0 ? (size_t)n : 1, sizeof(long long));
+	if(!counts) {
+		fprintf(stderr, "error : calloc()\n");
+		exit(1);
+	}
+	return counts;
+}
+
 /* Prints an array t of n integers */
 void print_array(int* t, int n)
 {
@@ -43,6 +115,64 @@ void print_array(int* t, int n)
 	fprintf(stdout, "\n");
 }
 
+/*
+	An enumeration of the permutations of n elements.
+	The state belongs to the caller, so several enumerations can be in progress at the same time :
+	init_permutation() starts it, next_permutation() provides each permutation,
+	free_permutation() ends it (even before the end of the loop).
+*/
+struct perm_iter {
+	int n;    /* Number of elements */
+	int* tp;  /* The array with the current permutation, NULL before the first call */
+	int done; /* YES once the loop is finished */
+};
+
+/* Starts the enumeration of the permutations of n elements */
+void init_permutation(struct perm_iter* it, int n)
+{
+	it->n = n;
+	it->tp = NULL;
+	it->done = NO;
+}
+
+/* Ends the enumeration of permutations */
+void free_permutation(struct perm_iter* it)
+{
+	free(it->tp);
+	it->tp = NULL;
+	it->done = YES;
+}
+
+/*
+	Packed arrangements : position i is in the bits 4*i to 4*i+3 of one integer, the unused bits are 0.
+	Several positions can then be compared at once (SWAR, SIMD Within A Register).
+*/
+#define NIBBLES_LOW 0x1111111111111111ULL /* The lowest bit of each 4 bits */
+
+/* Packs the arrangement ta[] of n positions into one integer (4 bits per position) */
+uint64_t pack_arrangement(const int* ta, int n)
+{
+	uint64_t code = 0;
+	for(int i=n-1 ; i>=0 ; i--)
+		code = (code << 4) | (uint64_t)ta[i];
+	return code;
+}
+
+/* Unpacks code into the arrangement ta[] of n positions */
+void unpack_arrangement(uint64_t code, int* ta, int n)
+{
+	for(int i=0 ; i<n ; i++, code >>= 4)
+		ta[i] = (int)(code & 0xF);
+}
+
+/* Returns a word with the bit 4*i set if the 4 bits of position i in x are not all 0 */
+uint64_t nonzero_nibbles(uint64_t x)
+{
+	x |= x >> 1;
+	x |= x >> 2;
+	return x & NIBBLES_LOW;
+}
+
 /*
 	Returns an array with the next permutation of n elements,
 	or NULL if the loop is finished.
@@ -73,11 +203,14 @@ void print_array(int* t, int n)
 		at 24th call returns 3 2 1 0
 		at 25th call returns NULL
 */
-int* next_permutation(int n)
+int* next_permutation(struct perm_iter* it)
 {
-	static int* tp = NULL; /* The array with the current permutation */
+	const int n = it->n;
+	int* tp = it->tp; /* The array with the current permutation */
+	if(it->done)
+		return NULL;
 	if(tp == NULL) { /* First call for this loop */
-		tp = new_array(n);
+		tp = it->tp = new_array(n);
 		int i;
 		for(i=0 ; i<n ; i++)
 			tp[i] = i;
@@ -85,9 +218,8 @@ int* next_permutation(int n)
 		int i, c, d, j, p;
 		for(i = n-1 ; tp[i] < tp[i-1] ; i--) { /* Set i to the position of the first ordered number */
 			if(i==1) { /* The last value has been reached */
-				free(tp);
-				tp = NULL;
-				return tp;
+				free_permutation(it);
+				return NULL;
 			}
 		}
 		c = tp[i-1]; /* The last unordered number */
@@ -109,6 +241,34 @@ int* next_permutation(int n)
 	return tp;
 }
 
+/*
+	An enumeration of the arrangements of n-1 elements in n positions,
+	built from the permutations of n elements.
+	As for permutations, init_arrangement(), next_arrangement() and free_arrangement()
+	work on a state that belongs to the caller.
+*/
+struct arr_iter {
+	int k;                 /* The element currently in double */
+	int p;                 /* Position of the element currently in double */
+	int* ta;               /* The array with the current arrangement, NULL before the first call */
+	struct perm_iter perm; /* The enumeration of permutations */
+};
+
+/* Starts the enumeration of the arrangements of n-1 elements in n positions */
+void init_arrangement(struct arr_iter* it, int n)
+{
+	it->ta = NULL;
+	init_permutation(&it->perm, n);
+}
+
+/* Ends the enumeration of arrangements */
+void free_arrangement(struct arr_iter* it)
+{
+	free(it->ta);
+	it->ta = NULL;
+	free_permutation(&it->perm);
+}
+
 /*
 	Returns an array with the next arrangement of n-1 elements in n positions
 	(one element is doubled),
@@ -141,48 +301,42 @@ int* next_permutation(int n)
 		at 36th call returns 2 2 1 0
 		at 37th call returns NULL
 */
-int* next_arrangement(int n)
+int* next_arrangement(struct arr_iter* it)
 {
-	static int k; /* The element currently in double */
-	static int p; /* Position of the element currently in double */
-	static int* ta = NULL; /* The array with the current arrangement */
+	const int n = it->perm.n;
+	int* ta = it->ta; /* The array with the current arrangement */
 
 	int skip = 1;
 	while(skip) { /* Need to restart all if this arrangement has already been provided */
 	skip = 0;
 
+		if(it->perm.done) /* The loop is finished */
+			return NULL;
+
 		if(ta == NULL) { /* First call for this loop */
-			ta = new_array(n);
-			k = n-2; /* The last possible value of k, to force the start a new permutation */
+			ta = it->ta = new_array(n);
+			it->k = n-2; /* The last possible value of k, to force the start a new permutation */
 		}
 
-		if(k == n-2) { /* First call for this permutation */
-			int* tp = next_permutation(n); /* Go to next permutation */
-			if(tp == NULL) { /* The loop is finished */
-				free(ta);
-				ta = NULL;
-				return ta;
-			}
-			if(tp[0] == n-1) { /* Little optimization : all the end already provided */
-				while(next_permutation(n))
-					; /* Finish all permutations */
-				free(ta);
-				ta = NULL;
-				return ta;
+		if(it->k == n-2) { /* First call for this permutation */
+			int* tp = next_permutation(&it->perm); /* Go to next permutation */
+			if(tp == NULL || tp[0] == n-1) { /* The loop is finished (with tp[0] == n-1, all the end already provided) */
+				free_arrangement(it);
+				return NULL;
 			}
 			for(int i=0 ; i<n ; i++) { /* Initialize our arrangement using the permutation */
 				ta[i] = tp[i]; /* Copy ta <- tp */
-				if(ta[i] == n-1) p = i; /* p is the position of the n_th element, that will be used for the double */
+				if(ta[i] == n-1) it->p = i; /* p is the position of the n_th element, that will be used for the double */
 			}
-			k = 0;
+			it->k = 0;
 		} else { /* Next arrangement for this permutation */
-			k++;
+			it->k++;
 		}
 
-		ta[p] = k; /* Set the new arrangement, with a new double element */
+		ta[it->p] = it->k; /* Set the new arrangement, with a new double element */
 
-		for(int i=p+1 ; i<n ; i++) /* Each arrangement has 2 occurrences, need to skip one of them */
-			if(ta[i] == k)
+		for(int i=it->p+1 ; i<n ; i++) /* Each arrangement has 2 occurrences, need to skip one of them */
+			if(ta[i] == it->k)
 				skip = 1;
 
 	} /* End while skip */
@@ -190,15 +344,290 @@ int* next_arrangement(int n)
 	return ta;
 }
 
+/* Returns 1*2*3*...*k */
+long long factorial(int k)
+{
+	long long f = 1;
+	for(int i=2 ; i<=k ; i++)
+		f *= i;
+	return f;
+}
+
+/* Returns the number of arrangements of m elements in n positions (m <= n <= 2*m),
+	each element at one or two positions, so n-m elements are doubled :
+	n_arr = (number of ways to choose the n-m doubled elements) * 1*2*3*...*n / 2^(n-m)
+*/
+long long n_arrangements_of(int n, int m)
+{
+	long long f = 1;
+	int i;
+	for(i=0 ; i<n-m ; i++) /* Choose the doubled elements : m*(m-1)*.../(1*2*...) */
+		f = f * (m-i) / (i+1);
+	for(i=2 ; i<=n ; i++)
+		f *= i;
+	return f >> (n-m);
+}
+
+/* Returns the number of arrangements of n-1 elements in n positions (one element is doubled)
+	n_arr = 1*2*3*...*n * (n-1) / 2
+*/
+long long n_arrangements(int n)
+{
+	return n_arrangements_of(n, n-1);
+}
+
+/*
+	Ranking of arrangements.
+	An arrangement of n-1 elements in n positions is described by :
+		d     the element in double (0 <= d < n-1)
+		p, q  the 2 positions of d (p < q), numbered by pair = 0 for (0,1), 1 for (0,2), ... n*(n-1)/2-1 for (n-2,n-1)
+		rest  the permutation of the n-2 other elements in the n-2 other positions,
+		      numbered by its place in the plain changes order (Steinhaus-Johnson-Trotter, see sjt_rank())
+	and its rank is : (d * n*(n-1)/2 + pair) * (n-2)! + sjt(rest)
+	So each arrangement has exactly one rank, between 0 and n_arr-1,
+	and 2 arrangements of consecutive ranks with the same d, p and q differ by the exchange of 2 positions
+	(see next_ranked() : the review of all arrangements updates the matches of the ceremonies with a few additions).
+	For example, with n == 4 :
+		rank  0 is 0 0 1 2
+		rank  1 is 0 0 2 1
+		rank  2 is 0 1 0 2
+		rank  3 is 0 2 0 1
+		...
+		rank 35 is 1 0 2 2
+*/
+
+/*
+	Plain changes order of the permutations of 0..m-1 : the permutations of 0..m-2 in this order,
+	with m-1 inserted at each place, from the last to the first place for the permutations of even rank,
+	and from the first to the last place for the ones of odd rank.
+	So 2 consecutive permutations differ by the exchange of 2 neighbours.
+	The rank is written with the mixed radix (1, 2, ... m) : its digit for m is the number of moves of m-1 in its sweep.
+*/
+
+/* Returns the rank of the permutation tp[] of 0..m-1 in the plain changes order */
+long long sjt_rank(int m, const int* tp)
+{
+	int k, i;
+	long long rank = 0;
+	int place[MAX_N]; /* place[k] : the place of k among the elements 0..k */
+	for(k=1 ; k<m ; k++) {
+		place[k] = 0;
+		for(i=0 ; tp[i] != k ; i++)
+			if(tp[i] < k)
+				place[k]++;
+	}
+	for(k=1 ; k<m ; k++) /* Inserting k among k elements */
+		rank = rank * (k+1) + (rank % 2 == 0 ? k - place[k] : place[k]);
+	return rank;
+}
+
+/* Sets tp[] to the permutation of 0..m-1 with the given rank in the plain changes order */
+void sjt_unrank(int m, long long rank, int* tp)
+{
+	int k, i;
+	long long sub[MAX_N+1]; /* sub[k] : the rank of the permutation of 0..k-1 */
+	sub[m] = rank;
+	for(k=m ; k>1 ; k--)
+		sub[k-1] = sub[k] / k;
+	for(k=0 ; k<m ; k++) { /* Insert k among the k elements before */
+		const int digit = (int)(sub[k+1] % (k+1));
+		const int place = sub[k] % 2 == 0 ? k - digit : digit;
+		for(i=k ; i>place ; i--)
+			tp[i] = tp[i-1];
+		tp[place] = k;
+	}
+}
+
+/* Returns the rank of the arrangement ta[] of n positions */
+long long rank_arrangement(int n, const int* ta)
+{
+	int p, q, i, d = -1, pair = 0, m = 0;
+	int tp[MAX_N];
+	for(p=0 ; d<0 ; p++) /* Find d, p and q */
+		for(q=p+1 ; q<n ; q++)
+			if(ta[p] == ta[q]) {
+				d = ta[p];
+				break;
+			}
+	p--;
+	pair = p*(2*n-p-1)/2 + (q-p-1);
+	for(i=0 ; i<n ; i++) /* The rest, as a permutation of 0..n-3 */
+		if(i != p && i != q)
+			tp[m++] = ta[i] - (ta[i] > d);
+	return (d * (n*(n-1)/2) + pair) * factorial(n-2) + sjt_rank(n-2, tp);
+}
+
+/* Sets ta[] to the arrangement of n positions with the given rank */
+void unrank_arrangement(int n, long long rank, int* ta)
+{
+	int i, p, q, m = 0;
+	int tp[MAX_N];
+	const long long fact = factorial(n-2);
+	const int n_pairs = n*(n-1)/2;
+	int pair = (int)((rank / fact) % n_pairs);
+	const int d = (int)(rank / fact / n_pairs);
+	for(p=0 ; pair >= n-p-1 ; p++) /* Find p and q from pair */
+		pair -= n-p-1;
+	q = p+1+pair;
+	sjt_unrank(n-2, rank % fact, tp);
+	for(i=0 ; i<n ; i++)
+		if(i == p || i == q)
+			ta[i] = d;
+		else {
+			ta[i] = tp[m] + (tp[m] >= d);
+			m++;
+		}
+}
+
+/*
+	A generator of arrangements, by increasing rank, from a first rank to a last rank,
+	with no duplicate. The state belongs to the caller.
+	The permutations of the rest follow the plain changes order with Knuth's algorithm P
+	(The Art of Computer Programming, 7.2.1.2) : each step exchanges 2 positions, in constant time on average.
+*/
+struct ranked_gen {
+	int n;            /* Number of positions */
+	long long rank;   /* Rank of the next arrangement to provide */
+	long long last;   /* Rank after the last arrangement to provide */
+	int d;            /* The element in double */
+	int p, q;         /* The 2 positions of d */
+	int rpos[MAX_N];  /* The n-2 other positions */
+	int rest[MAX_N];  /* The n-2 other elements, in the order of rpos[] */
+	int ta[MAX_N];    /* The current arrangement */
+	uint64_t code;    /* The current arrangement, packed */
+	int started;      /* NO before the first call of next_ranked() */
+	int c[MAX_N+1];   /* Algorithm P : c[k] the moves of the element k-1 of the rest in its sweep */
+	int o[MAX_N+1];   /* Algorithm P : o[k] the direction of these moves (1 or -1) */
+	int swap_a, swap_b; /* The 2 positions exchanged by the last call of next_ranked(), or -1 if more changed */
+};
+
+/* Fills d, p, q, rpos[] and rest[] of g from g->ta[] */
+void ranked_gen_split(struct ranked_gen* g)
+{
+	int i, m = 0;
+	for(g->p=0 ; ; g->p++) {
+		for(g->q=g->p+1 ; g->q<g->n && g->ta[g->q]!=g->ta[g->p] ; g->q++)
+			;
+		if(g->q < g->n)
+			break;
+	}
+	g->d = g->ta[g->p];
+	for(i=0 ; i<g->n ; i++)
+		if(i != g->p && i != g->q) {
+			g->rpos[m] = i;
+			g->rest[m] = g->ta[i];
+			m++;
+		}
+}
+
+/* Sets c[] and o[] of g for the permutation of the rest of the given rank (see sjt_unrank()) */
+void ranked_gen_moves(struct ranked_gen* g, long long rank)
+{
+	int k;
+	const int m = g->n-2;
+	long long sub[MAX_N+1];
+	sub[m > 0 ? m : 0] = rank;
+	for(k=m ; k>1 ; k--)
+		sub[k-1] = sub[k] / k;
+	for(k=1 ; k<=m ; k++) {
+		const int digit = (int)(sub[k] % k);
+		g->o[k] = sub[k-1] % 2 == 0 ? 1 : -1;
+		g->c[k] = g->o[k] > 0 ? digit : k-1 - digit; /* The moves from the end where k-1 starts */
+	}
+}
+
+/* Starts g to provide the arrangements of n positions with rank from first to last-1 */
+void init_ranked(struct ranked_gen* g, int n, long long first, long long last)
+{
+	g->n = n;
+	g->rank = first;
+	g->last = last;
+	g->started = NO;
+	g->swap_a = g->swap_b = -1;
+	if(first < last) {
+		unrank_arrangement(n, first, g->ta);
+		g->code = pack_arrangement(g->ta, n);
+		ranked_gen_split(g);
+		ranked_gen_moves(g, first % factorial(n-2));
+	}
+}
+
+/* Returns an array with the next arrangement of g, or NULL if the loop is finished */
+int* next_ranked(struct ranked_gen* g)
+{
+	int i, j, t, k, s, q;
+	const int n = g->n;
+	const int m = n-2;
+	if(g->rank >= g->last)
+		return NULL;
+	if(!g->started) { /* The first arrangement has been set by init_ranked() */
+		g->started = YES;
+		g->rank++;
+		return g->ta;
+	}
+	/* Next permutation of rest[], in plain changes order (algorithm P) */
+	for(k=m, s=0 ; k>1 ; k--) {
+		q = g->c[k] + g->o[k];
+		if(q >= 0 && q < k)
+			break;
+		if(q == k) /* k-1 is at the start of its sweep : the smaller ones are shifted */
+			s++;
+		g->o[k] = -g->o[k];
+	}
+	if(k > 1) { /* Exchange 2 neighbours of the rest */
+		const int a = k - 1 - g->c[k] + s;
+		const int b = k - 1 - q + s;
+		g->c[k] = q;
+		t = g->rest[a]; g->rest[a] = g->rest[b]; g->rest[b] = t;
+		g->swap_a = g->rpos[a];
+		g->swap_b = g->rpos[b];
+		g->ta[g->swap_a] = g->rest[a];
+		g->ta[g->swap_b] = g->rest[b];
+		g->code ^= ((uint64_t)(g->rest[a] ^ g->rest[b]) << (4*g->swap_a)) | ((uint64_t)(g->rest[a] ^ g->rest[b]) << (4*g->swap_b));
+	} else { /* All permutations of rest[] are done : next pair, or next element in double */
+		if(++g->q == n) {
+			if(++g->p == n-1) {
+				g->p = 0;
+				g->d++;
+			}
+			g->q = g->p+1;
+		}
+		for(i=0, j=0, t=0 ; i<n ; i++) { /* rest[] starts with the elements in increasing order */
+			if(i == g->p || i == g->q) {
+				g->ta[i] = g->d;
+				continue;
+			}
+			if(t == g->d)
+				t++;
+			g->rpos[j] = i;
+			g->rest[j] = t;
+			g->ta[i] = t;
+			j++;
+			t++;
+		}
+		for(k=1 ; k<=m ; k++) {
+			g->c[k] = 0;
+			g->o[k] = 1;
+		}
+		g->code = pack_arrangement(g->ta, n);
+		g->swap_a = g->swap_b = -1;
+	}
+	g->rank++;
+	return g->ta;
+}
+
 void test_permutation()
 {
 	int i, n;
 	int* tp;
+	struct perm_iter it;
 	for(n=2 ; n<8 ; n++) {
 		fprintf(stdout, "n = %d\n", n);
-		for(i=0 ; (tp=next_permutation(n)) != NULL ; i++) {
+		init_permutation(&it, n);
+		for(i=0 ; (tp=next_permutation(&it)) != NULL ; i++) {
 			print_array(tp, n);
 		}
+		free_permutation(&it);
 		fprintf(stdout, "i = %d\n\n", i);
 	}
 }
@@ -207,288 +636,2715 @@ void test_arrangement()
 {
 	int i, n;
 	int* ta;
+	struct arr_iter it;
 	for(n=2 ; n<8 ; n++) {
 		fprintf(stdout, "n = %d\n", n);
-		for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++) {
+		init_arrangement(&it, n);
+		for(i=0 ; (ta=next_arrangement(&it)) != NULL ; i++) {
 			print_array(ta, n);
 		}
+		free_arrangement(&it);
 		fprintf(stdout, "i = %d\n\n", i);
 	}
 }
 
+void test_rank()
+{
+	int i, n;
+	int* ta;
+	int t[MAX_N];
+	int prev[MAX_N];
+	struct ranked_gen g, h;
+	for(n=2 ; n<8 ; n++) {
+		const int n_arr = (int)n_arrangements(n);
+		int errors = 0;
+		fprintf(stdout, "n = %d\n", n);
+		init_ranked(&g, n, 0, n_arr);
+		for(i=0 ; (ta=next_ranked(&g)) != NULL ; i++) {
+			unrank_arrangement(n, i, t);
+			for(int j=0 ; j<n ; j++) {
+				if(t[j] != ta[j])
+					errors++;
+				if(g.swap_a >= 0 && j != g.swap_a && j != g.swap_b && ta[j] != prev[j]) /* Only 2 positions change */
+					errors++;
+				prev[j] = ta[j];
+			}
+			if(g.code != pack_arrangement(ta, n))
+				errors++;
+			if(rank_arrangement(n, ta) != i)
+				errors++;
+			init_ranked(&h, n, i, n_arr); /* Starting anywhere gives the same next arrangements */
+			next_ranked(&h);
+			if(i+1 < n_arr) {
+				next_ranked(&h);
+				unrank_arrangement(n, i+1, t);
+				for(int j=0 ; j<n ; j++)
+					if(t[j] != h.ta[j])
+						errors++;
+			}
+			if(n < 5) {
+				fprintf(stdout, "%d\t", i);
+				print_array(ta, n);
+			}
+		}
+		fprintf(stdout, "i = %d / %d, errors = %d\n\n", i, n_arr, errors);
+	}
+}
+
 void test_eleven()
 {
 	int i;
 	int n = 11;
 	int* ta;
-	for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++)
+	struct arr_iter it;
+	init_arrangement(&it, n);
+	for(i=0 ; (ta=next_arrangement(&it)) != NULL ; i++)
 		;
+	free_arrangement(&it);
 	printf("i = %d\n", i);
 }
 
-/* Creates and init the array is_right[] */
-int* init_is_right(int n_arr)
+/* A set of n_bits bits, stored by words of 64 bits */
+struct bitset {
+	long long n_bits;  /* Number of bits */
+	long long n_words; /* Number of words */
+	uint64_t* words; /* Bit b is (words[b/64] >> (b%64)) & 1 ; unused bits of the last word are 0 */
+	int mapped;      /* YES if words[] is in a file mapped in memory (see load_snapshot()), not to be freed */
+	long long first; /* The arrangement (rank) of bit 0 : 0, or the first one of a window of a spill (see struct spill) */
+};
+
+/* Number of bits set in a word */
+int popcount(uint64_t word)
 {
-	int* is_right = new_array(n_arr);
-	for(int i=0 ; i<n_arr ; i++)
-		is_right[i] = 1; /* At the beginning; all arrangements are possible */
-	return is_right;
+#ifdef __GNUC__
+	return __builtin_popcountll(word);
+#else
+	int count = 0;
+	for( ; word ; word &= word - 1)
+		count++;
+	return count;
+#endif
 }
 
-/* Prints names of n-1 elements and n positions
-	gender == 0 -> elements are boys, positions are girls
-	gender == 1 -> elements are girls, positions are boys
-*/
-void print_names(int n, int gender, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+/* Creates a bitset of n_bits bits, all set */
+struct bitset* new_bitset(long long n_bits)
 {
-	int i;
-	printf("The %s are :\n", (gender?"boys":"girls"));
-	for(i=0 ; i<n ; i++)
-		fprintf(stdout, "\tpos=%d\t%s\n", i, npos[i]);
-	printf("\n");
-	printf("The %s are :\n", (gender?"girls":"boys"));
-	for(i=0 ; i<n-1 ; i++)
-		fprintf(stdout, "\telt=%d\t%s\n", i, nelt[i]);
-	printf("\n");
+	struct bitset* bs = (struct bitset*)malloc(sizeof(struct bitset));
+	if(!bs) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	bs->n_bits = n_bits;
+	bs->n_words = (n_bits + 63) / 64;
+	bs->words = new_codes(bs->n_words);
+	bs->mapped = NO;
+	bs->first = 0;
+	for(long long w=0 ; w<bs->n_words ; w++)
+		bs->words[w] = ~(uint64_t)0;
+	if(n_bits % 64) /* Clear the unused bits of the last word */
+		bs->words[bs->n_words-1] = ((uint64_t)1 << (n_bits % 64)) - 1;
+	return bs;
 }
 
-/* Prints the current state of is_right[]
-	(This is for control purpose)
+/* Frees a bitset */
+void free_bitset(struct bitset* bs)
+{
+	if(bs && !bs->mapped)
+		free(bs->words);
+	free(bs);
+}
+
+/* Number of bits in word w of a bitset */
+int bitset_word_size(const struct bitset* bs, long long w)
+{
+	return (w < bs->n_words-1) ? 64 : (int)(bs->n_bits - 64*w);
+}
+
+/* Number of bits set in a bitset */
+long long bitset_count(const struct bitset* bs)
+{
+	long long count = 0;
+	for(long long w=0 ; w<bs->n_words ; w++)
+		count += popcount(bs->words[w]);
+	return count;
+}
+
+/*
+	Out-of-core bitset (option --spill DIR) : when the bitset does not fit in memory (n = 12 or 13),
+	it is kept in a file of DIR, cut into chunks of CHUNK_WORDS words, each one compressed by runs of words.
+	A run is a 16-bit head, its kind (RUN_ZEROS, RUN_ONES or RUN_WORDS) in the 2 high bits and its number of words below,
+	followed by its words for RUN_WORDS : once the events have eliminated most arrangements, most runs are zeros.
+	The chunks are read SPILL_WINDOW at a time into a window, a bitset whose bit 0 is the arrangement first,
+	and a review writes the chunks again to a new file (see spill_sweep()), so the memory is 2 windows whatever n.
 */
-void print_is_right(int n, int* is_right)
+#define CHUNK_WORDS  1024 /* Number of words of is_right in a chunk (see run_sweep()), also the chunks of a spill */
+#define SPILL_WINDOW 256  /* Number of chunks read at once (2 MB of words) */
+#define SPILL_MAX    (CHUNK_WORDS*10) /* Max size of a compressed chunk in bytes (a run of 1 word every 2 words) */
+#define RUN_ZEROS    0    /* Run of words 0 */
+#define RUN_ONES     1    /* Run of words with all bits set */
+#define RUN_WORDS    2    /* Run of words as is */
+
+const char* spill_dir = NULL; /* The directory of the out-of-core bitset, or NULL to keep it in memory (option --spill) */
+
+/* A bitset of n_bits bits in a file, by compressed chunks */
+struct spill {
+	char* file;          /* The name of the file */
+	FILE* out;           /* The file being written (see spill_write()), or NULL */
+	int fd;              /* The file opened for reading once written, or -1 */
+	long long n_bits;    /* Number of bits */
+	long long n_words;   /* Number of words */
+	long long n_chunks;  /* Number of chunks */
+	long long n_written; /* Number of chunks written */
+	long long* offset;   /* Chunk c is from offset[c] to offset[c+1] in the file (size = n_chunks+1) */
+	int kept;            /* YES if a delta keeps this spill to cancel events (see apply_events_undoable()) */
+};
+
+/* Compresses the n_words words[] into out[] (at least SPILL_MAX bytes), and returns the size */
+int spill_encode(const uint64_t* words, int n_words, unsigned char* out)
 {
-	int i;
-	int* ta;
-	printf("Current is_right[] :\n");
-	for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++) {
-		fprintf(stdout, "%s\t", is_right[i] ? "yes" : "no ");
-		print_array(ta, n);
+	int i = 0, j, size = 0;
+	while(i < n_words) {
+		int kind = RUN_WORDS;
+		if(words[i] == 0 || words[i] == ~(uint64_t)0) {
+			kind = words[i] ? RUN_ONES : RUN_ZEROS;
+			for(j=i+1 ; j<n_words && words[j] == words[i] ; j++)
+				;
+		} else
+			for(j=i+1 ; j<n_words && words[j] != 0 && words[j] != ~(uint64_t)0 ; j++)
+				;
+		const uint16_t head = (uint16_t)(kind << 14 | (j-i));
+		memcpy(out + size, &head, sizeof(head));
+		size += sizeof(head);
+		if(kind == RUN_WORDS) {
+			memcpy(out + size, words + i, (j-i) * sizeof(uint64_t));
+			size += (j-i) * sizeof(uint64_t);
+		}
+		i = j;
 	}
-	printf("\n");
+	return size;
 }
 
-/* Prints probability of having each element to each position */
-void print_proba_right(int n, int* is_right, int nb_right, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+/* Uncompresses the size bytes in[] (one or several chunks) into words[] */
+void spill_decode(const unsigned char* in, long long size, uint64_t* words)
 {
-	int i, pos, elt;
-	const int nsq = n * (n-1); /* Number of couples (element,position) */
+	long long i = 0;
+	while(i < size) {
+		uint16_t head;
+		memcpy(&head, in + i, sizeof(head));
+		i += sizeof(head);
+		const int kind = head >> 14, len = head & 0x3FFF;
+		if(kind == RUN_WORDS) {
+			memcpy(words, in + i, len * sizeof(uint64_t));
+			i += len * sizeof(uint64_t);
+		} else
+			for(int k=0 ; k<len ; k++)
+				words[k] = (kind == RUN_ONES) ? ~(uint64_t)0 : 0;
+		words += len;
+	}
+}
 
-	/* Init proba_right[] */
-	int* proba_right = new_array(nsq);
-	for(i=0 ; i<nsq ; i++)
-		proba_right[i] = 0;
+/* Creates an empty spill of n_bits bits in a new file of spill_dir, to fill with spill_write() */
+struct spill* new_spill(long long n_bits)
+{
+	static int n_files = 0; /* Number of files created by this process */
+	struct spill* sp = (struct spill*)malloc(sizeof(struct spill));
+	if(!sp || !(sp->file = (char*)malloc(strlen(spill_dir) + 64))) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	sprintf(sp->file, "%s/spill-%ld-%d.bin", spill_dir, (long)getpid(), n_files++);
+	if((sp->out = fopen(sp->file, "wb")) == NULL) {
+		fprintf(stderr, "error : fopen() : %s\n", sp->file);
+		exit(1);
+	}
+	sp->fd = -1;
+	sp->n_bits = n_bits;
+	sp->n_words = (n_bits + 63) / 64;
+	sp->n_chunks = (sp->n_words + CHUNK_WORDS-1) / CHUNK_WORDS;
+	sp->n_written = 0;
+	sp->offset = new_counts(sp->n_chunks + 1);
+	sp->offset[0] = 0;
+	sp->kept = NO;
+	return sp;
+}
 
-	/* Fill proba_right[] */
-	int* ta; /* One possible arrangement (size = n) */
-	for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++) {
-		if(is_right[i] == 1) {
-			for(pos=0 ; pos<n ; pos++) {
-				elt = ta[pos];
-				proba_right[elt*n+pos]++; /* ta[pos] is elt */
-			}
+/* Appends the n_words words[] to the spill sp : whole chunks, but the last one */
+void spill_write(struct spill* sp, const uint64_t* words, long long n_words)
+{
+	unsigned char buf[SPILL_MAX];
+	for(long long w=0 ; w<n_words ; w+=CHUNK_WORDS) {
+		const int size = spill_encode(words + w, n_words - w < CHUNK_WORDS ? (int)(n_words - w) : CHUNK_WORDS, buf);
+		if(fwrite(buf, 1, size, sp->out) != (size_t)size) {
+			fprintf(stderr, "error : cannot write %s\n", sp->file);
+			exit(1);
 		}
+		sp->offset[sp->n_written+1] = sp->offset[sp->n_written] + size;
+		sp->n_written++;
 	}
-
-	/* Prints proba_right[] */
-	fprintf(stdout, "Number of possible arrangements : %d / %d\n", nb_right, i);
-	fprintf(stdout, ".\t."); /* First header */
-	for(pos=0 ; pos<n ; pos++)
-		fprintf(stdout, "\tpos=%d", pos);
-	fprintf(stdout, "\n");
-	fprintf(stdout, ".\t."); /* Second header */
-	for(pos=0 ; pos<n ; pos++)
-		fprintf(stdout, "\t%s", npos[pos]);
-	fprintf(stdout, "\n");
-	for(elt=0 ; elt<n-1 ; elt++) { /* Content */
-		fprintf(stdout, "elt=%d", elt);
-		fprintf(stdout, "\t%s", nelt[elt]);
-		for(pos=0 ; pos<n ; pos++) {
-			if(nb_right == 0)
-				fprintf(stdout, "\t X    ");
-			else if(proba_right[elt*n+pos] == 0)
-				fprintf(stdout, "\t  0%% ");
-			else if(proba_right[elt*n+pos] == nb_right)
-				fprintf(stdout, "\t100%% ");
-			else
-				fprintf(stdout, "\t%4.1f%%", 100*(double)proba_right[elt*n+pos]/nb_right);
+	if(sp->n_written == sp->n_chunks) { /* All written : ready to read */
+		if(fclose(sp->out) != 0 || (sp->fd = open(sp->file, O_RDONLY)) < 0) {
+			fprintf(stderr, "error : cannot write %s\n", sp->file);
+			exit(1);
 		}
-		fprintf(stdout, "\n");
+		sp->out = NULL;
 	}
-	fprintf(stdout, "\n");
+}
 
-	/* End */
-	free(proba_right);
-	fflush(stdout);
+/* Creates a spill of n_bits bits, all set */
+struct spill* init_spill(long long n_bits)
+{
+	struct spill* sp = new_spill(n_bits);
+	uint64_t* ones = new_codes(CHUNK_WORDS);
+	for(int w=0 ; w<CHUNK_WORDS ; w++)
+		ones[w] = ~(uint64_t)0;
+	for(long long c=0 ; c<sp->n_chunks-1 ; c++)
+		spill_write(sp, ones, CHUNK_WORDS);
+	const long long last = sp->n_words - (sp->n_chunks-1) * CHUNK_WORDS; /* Words of the last chunk */
+	if(n_bits % 64) /* Clear the unused bits of the last word */
+		ones[last-1] = ((uint64_t)1 << (n_bits % 64)) - 1;
+	spill_write(sp, ones, last);
+	free(ones);
+	return sp;
 }
 
-/* Updates the array is_right[] knowing that elt is associated (or not) to pos,
-	and returns the new value for nb_right
-	if couple == 1 then it's a couple
-	if couple == 0 then it's not a couple
-*/
-int add_new_couple(int n, int* is_right, int couple, int elt, int pos, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+/* Frees the spill sp, and removes its file */
+void free_spill(struct spill* sp)
 {
-	int* ta;
-	int nb_right = 0;
-	fprintf(stdout, "%s %s in couple with %s\n",
-		nelt[elt],
-		couple ? "is" : "is not",
-		npos[pos]);
-	for(int i=0 ; (ta=next_arrangement(n)) != NULL ; i++)
-		if(is_right[i] == 1) {
-			if(
-				(( couple) && (ta[pos] != elt)) ||
-				((!couple) && (ta[pos] == elt))
-				)
-				is_right[i] = 0;
-			else
-				nb_right ++;
-		}
-	return nb_right;
+	if(!sp)
+		return;
+	if(sp->out)
+		fclose(sp->out);
+	if(sp->fd >= 0)
+		close(sp->fd);
+	unlink(sp->file);
+	free(sp->file);
+	free(sp->offset);
+	free(sp);
 }
 
-/* Updates the array is_right[] knowing a ceremony;
-	we have a set of n-1 couples, and the number of matches (the right couples),
-	and returns the new value for nb_right
-	a_elt[] has a size of n, but only n-1 positions are experimented (one position stays alone)
-	for the alone position, a_elt[] is -1
-*/
-int add_ceremony(int n, int* is_right, const int* a_elt, int matches, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+/* Number of windows of the spill sp */
+long long spill_windows(const struct spill* sp)
 {
-	int i, j;
-	int* ta;
-	int nb_right = 0;
-	fprintf(stdout, "A new ceremony :\n");
-	for(i=0 ; i<n ; i++)
-		if(a_elt[i] == -1)
-			printf("(pos=%d) %s stays alone\n", i, npos[i]);
-		else
-			printf("(pos=%d,elt=%d) %s with %s\n", i, a_elt[i], npos[i], nelt[a_elt[i]]);
-	printf("We have %d matches\n", matches);
-	for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++)
-		if(is_right[i] == 1) {
-			/* Count how many common couple between a_elt[] and ta[] */
-			int nb_matches = 0;
-			for(j=0 ; j<n ; j++)
-				if(ta[j] == a_elt[j]) /* It also handles the case of a_elt[j] == -1 */
-					nb_matches++;
-
-			/* If same matches, then ta[] is a possible solution */
-			if(nb_matches == matches)
-				nb_right ++;
-			else
-				is_right[i] = 0;
-		}
-	return nb_right;
+	return (sp->n_chunks + SPILL_WINDOW-1) / SPILL_WINDOW;
 }
 
-/* Updates the array is_right[] knowing that pos is the doublon
-	and returns the new value for nb_right
-*/
-int add_the_doublon(int n, int* is_right, int pos, const char npos[][MAX_NAME+1])
+/* Creates a bitset for the windows of a spill */
+struct bitset* new_window()
 {
-	int i, j;
-	int* ta;
-	int nb_right = 0;
-	fprintf(stdout, "We know who is the doublon : %s\n", npos[pos]);
-	for(i=0 ; (ta=next_arrangement(n)) != NULL ; i++)
-		if(is_right[i] == 1) {
-			/* Count how many common couple between a_elt[] and ta[] */
-			int doublon = NO;
-			for(j=0 ; j<n ; j++)
-				if((j != pos) && ta[j] == ta[pos])
-					doublon = YES;
-
-			/* If pos is the doublon, then ta[] is a possible solution */
-			if(doublon == YES)
-				nb_right ++;
-			else
-				is_right[i] = 0;
+	struct bitset* bs = (struct bitset*)malloc(sizeof(struct bitset));
+	if(!bs) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	bs->words = new_codes((long long)SPILL_WINDOW * CHUNK_WORDS);
+	bs->mapped = NO;
+	bs->n_bits = bs->n_words = bs->first = 0;
+	return bs;
+}
+
+/* Reads the window win of the spill sp into the bitset bs (see new_window()) */
+void spill_read(const struct spill* sp, long long win, struct bitset* bs)
+{
+	const long long c0 = win * SPILL_WINDOW;
+	const long long c1 = c0 + SPILL_WINDOW < sp->n_chunks ? c0 + SPILL_WINDOW : sp->n_chunks;
+	const long long size = sp->offset[c1] - sp->offset[c0];
+	unsigned char* buf = (unsigned char*)malloc(size > 0 ? size : 1);
+	if(!buf) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	for(long long done=0 ; done<size ; ) {
+		const ssize_t got = pread(sp->fd, buf + done, size - done, (off_t)(sp->offset[c0] + done));
+		if(got <= 0) {
+			fprintf(stderr, "error : cannot read %s\n", sp->file);
+			exit(1);
 		}
-	return nb_right;
+		done += got;
+	}
+	spill_decode(buf, size, bs->words);
+	free(buf);
+	bs->first = 64 * c0 * CHUNK_WORDS;
+	bs->n_words = (c1 < sp->n_chunks ? c1 * CHUNK_WORDS : sp->n_words) - c0 * CHUNK_WORDS;
+	bs->n_bits = (c1 < sp->n_chunks ? 64 * c1 * CHUNK_WORDS : sp->n_bits) - bs->first;
 }
 
-/* Test of every functions,
-	assuming that the answer is (0, 1, 2, 3, 4, 5, 5)
+/* Read-ahead of a window of a spill by another thread */
+struct spill_reader {
+	pthread_t thread;
+	const struct spill* sp;
+	long long win;
+	struct bitset* bs;
+};
+
+/* Main function of a read-ahead */
+void* run_spill_reader(void* arg)
+{
+	struct spill_reader* rd = (struct spill_reader*)arg;
+	spill_read(rd->sp, rd->win, rd->bs);
+	return NULL;
+}
+
+/*
+	The set of arrangements that are still possible.
+	At the beginning, the bitset is_right says for each arrangement (by rank, see rank_arrangement())
+	if it is possible or not, so each event has to review all arrangements
+	(but the blocks of 64 impossible arrangements are jumped).
+	Once less than n_arr / SURV_RATIO arrangements are possible, is_right is freed,
+	and the possible arrangements are kept packed in surv[], so an event only reviews them.
+	With --spill, is_right is on disk (see struct spill) until the list fits in SPILL_LIST codes.
+	The counts proba_right[] are kept up to date : an event subtracts the arrangements it eliminates,
+	so the probabilities can be read at any time with no review.
+	All counts and ranks are 64 bits : from n = 12, there are more than 2^31 arrangements.
 */
-void test_small()
+struct right {
+	long long n_arr;          /* Number of arrangements */
+	long long nb_right;       /* Number of possible arrangements */
+	struct bitset* is_right;  /* For each arrangement (size = n_arr), says if this arrangement is possible (=1) or not (=0), or NULL */
+	struct spill* spill;      /* is_right on disk (option --spill), or NULL */
+	uint64_t* surv;           /* The possible arrangements, packed (size = nb_right), or NULL while is_right is used */
+	long long* proba_right;   /* Number of possible arrangements with elt at pos, in proba_right[elt*n+pos] */
+	void* map;                /* The snapshot file mapped in memory, that is_right can use, or NULL */
+	size_t map_size;          /* Size of map */
+};
+
+/* Creates and init the set of possible arrangements for n positions */
+struct right* init_right(int n)
 {
-	int elt, pos, couple, matches;
+	int i;
+	const long long n_arr = n_arrangements(n);
+	struct right* right = (struct right*)malloc(sizeof(struct right));
+	if(!right) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	right->n_arr = n_arr;
+	right->nb_right = n_arr; /* At the beginning, all arrangements are possible */
+	right->is_right = spill_dir ? NULL : new_bitset(n_arr);
+	right->spill = spill_dir ? init_spill(n_arr) : NULL;
+	right->surv = NULL;
+	right->proba_right = new_counts(n*(n-1));
+	for(i=0 ; i<n*(n-1) ; i++) /* Each element fills n positions of the n*(n-1) couples of n_arr / (n-1) arrangements */
+		right->proba_right[i] = n_arr / (n-1);
+	right->map = NULL;
+	right->map_size = 0;
+	return right;
+}
 
-	const int n = 7;         /* Number of elements and positions; we have n-1 elements in n positions */
-	const int n_arr = 15120; /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
-	const char npos[7][MAX_NAME+1] = { "Ah", "Do", "Ve", "So", "Gi", "Co", "Ta" };
-	const char nelt[6][MAX_NAME+1] = { "Ka", "Ke", "Ki", "Ko", "Ku", "Ky" };
+/* Frees the set of possible arrangements */
+void free_right(struct right* right)
+{
+	free_bitset(right->is_right);
+	if(right->spill && !right->spill->kept)
+		free_spill(right->spill);
+	free(right->surv);
+	free(right->proba_right);
+	if(right->map)
+		munmap(right->map, right->map_size);
+	free(right);
+}
 
-	/* Init is_right[] */
-	int* is_right = init_is_right(n_arr); /* For each arrangement (size = n_arr), says if this arrangement is possible (=1) or not (=0) */
-	int nb_right = n_arr;
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+/* Kinds of event */
+#define EV_COUPLE   0 /* Truth booth : elt is (or is not) in couple with pos */
+#define EV_CEREMONY 1 /* Ceremony : a_elt[] has exactly matches right couples */
+#define EV_DOUBLON  2 /* pos is the doublon */
 
-	/* add_new_couple() */
-	elt = 3;
+/* One event of the game, that makes some arrangements impossible */
+struct event {
+	int type;         /* EV_COUPLE, EV_CEREMONY or EV_DOUBLON */
+	int couple;       /* EV_COUPLE : YES if it's a couple, NO if it's not a couple */
+	int elt;          /* EV_COUPLE : the element */
+	int pos;          /* EV_COUPLE and EV_DOUBLON : the position */
+	int matches;      /* EV_CEREMONY : the number of matches */
+	int a_elt[MAX_N]; /* EV_CEREMONY : the element tested with each position, or -1 */
+};
+
+/*
+	Several events compiled into one test, to apply them in one review.
+	The truth booths are merged into the set of elements allowed at each position, and are tested first,
+	then the doublons, and the ceremonies last, so most arrangements are rejected before counting matches.
+	Counting the matches of a ceremony stops as soon as the number of matches can not be reached.
+	For the reviews of all arrangements (see sweep_chunk()), the matches of up to 16 ceremonies are also counted
+	at once, 4 bits each in a word (a ceremony has at most n-1 <= 15 matches) : cer_hits[] gives the matches
+	brought by each element at each position, so the exchange of 2 positions by next_ranked() updates
+	the matches of all ceremonies with 4 additions.
+*/
+struct predicate {
+	int n_booth;                    /* Number of positions with a truth booth */
+	int booth_pos[MAX_N];           /* These positions */
+	int booth_allowed[MAX_N];       /* Bit elt of booth_allowed[i] is set if elt is still allowed at booth_pos[i] */
+	int n_doublon;                  /* Number of positions known as the doublon */
+	int doublon_pos[MAX_N];         /* These positions */
+	uint64_t doublon_mask[MAX_N];   /* The positions (lowest bit of their 4 bits) to compare with doublon_pos[i] */
+	int n_ceremony;                 /* Number of ceremonies */
+	uint64_t* cer_code;             /* The ceremonies, packed, with 0xF for the alone position and beyond n (size = n_ceremony) */
+	int* cer_differ;                /* The number of the 16 packed positions that must differ from cer_code[] (size = n_ceremony) */
+	int cer_counted;                /* YES if the matches are counted in cer_hits[] (n_ceremony <= 16) */
+	uint64_t cer_hits[MAX_N*16];    /* Nibble i of cer_hits[pos*16+elt] is 1 if the ceremony i has elt at pos */
+	uint64_t cer_matches;           /* Nibble i is the number of matches of the ceremony i */
+};
+
+#define ALL_ELTS ((1 << (MAX_N-1)) - 1) /* Bit elt is set for every element that can exist */
+
+/* Compiles the n_ev events evs[] into pred */
+void compile_events(int n, struct predicate* pred, const struct event* evs, int n_ev)
+{
+	int i, j, allowed[MAX_N];
+	for(j=0 ; j<n ; j++)
+		allowed[j] = ALL_ELTS; /* All elements are allowed */
+	pred->n_doublon = 0;
+	pred->n_ceremony = 0;
+	pred->cer_code = new_codes(n_ev);
+	pred->cer_differ = new_array(n_ev > 0 ? n_ev : 1);
+	for(i=0 ; i<n_ev ; i++) {
+		const struct event* ev = &evs[i];
+		switch(ev->type) {
+		case EV_COUPLE:
+			if(ev->couple == YES)
+				allowed[ev->pos] &= 1 << ev->elt;
+			else
+				allowed[ev->pos] &= ~(1 << ev->elt);
+			break;
+		case EV_DOUBLON:
+			for(j=0 ; j<pred->n_doublon && pred->doublon_pos[j] != ev->pos ; j++)
+				;
+			if(j == pred->n_doublon) {
+				pred->doublon_pos[j] = ev->pos;
+				pred->doublon_mask[j] = 0;
+				for(int k=0 ; k<n ; k++)
+					if(k != ev->pos)
+						pred->doublon_mask[j] |= (uint64_t)1 << (4*k);
+				pred->n_doublon++;
+			}
+			break;
+		case EV_CEREMONY: {
+			uint64_t code = ~(uint64_t)0;
+			for(j=n-1 ; j>=0 ; j--)
+				code = (code << 4) | (uint64_t)(ev->a_elt[j] & 0xF); /* -1 gives 0xF */
+			pred->cer_code[pred->n_ceremony] = code;
+			pred->cer_differ[pred->n_ceremony] = 16 - ev->matches;
+			pred->n_ceremony++;
+			break;
+		}
+		}
+	}
+	pred->cer_counted = (pred->n_ceremony > 0 && pred->n_ceremony <= 16);
+	memset(pred->cer_hits, 0, sizeof(pred->cer_hits));
+	pred->cer_matches = 0;
+	for(i=0 ; pred->cer_counted && i<pred->n_ceremony ; i++) {
+		for(j=0 ; j<n ; j++) {
+			const int elt = (pred->cer_code[i] >> (4*j)) & 0xF;
+			if(elt != 0xF)
+				pred->cer_hits[j*16+elt] |= (uint64_t)1 << (4*i);
+		}
+		pred->cer_matches |= (uint64_t)(16 - pred->cer_differ[i]) << (4*i);
+	}
+	pred->n_booth = 0;
+	for(j=0 ; j<n ; j++)
+		if(allowed[j] != ALL_ELTS) {
+			pred->booth_pos[pred->n_booth] = j;
+			pred->booth_allowed[pred->n_booth] = allowed[j];
+			pred->n_booth++;
+		}
+}
+
+/* Frees what compile_events() has allocated */
+void free_predicate(struct predicate* pred)
+{
+	free(pred->cer_code);
+	free(pred->cer_differ);
+	pred->cer_code = NULL;
+	pred->cer_differ = NULL;
+}
+
+/* Returns YES if the packed arrangement code is still possible knowing the truth booths and doublons of pred, NO otherwise */
+int is_possible_booths(uint64_t code, const struct predicate* pred)
+{
+	int i;
+	for(i=0 ; i<pred->n_booth ; i++)
+		if(!((pred->booth_allowed[i] >> ((code >> (4*pred->booth_pos[i])) & 0xF)) & 1))
+			return NO;
+	for(i=0 ; i<pred->n_doublon ; i++) { /* Some other position has the same element */
+		const uint64_t elt = (code >> (4*pred->doublon_pos[i])) & 0xF;
+		if((~nonzero_nibbles(code ^ (elt * NIBBLES_LOW)) & pred->doublon_mask[i]) == 0)
+			return NO;
+	}
+	return YES;
+}
+
+/* Returns YES if the packed arrangement code is still possible knowing all events of pred, NO otherwise */
+int is_possible_all(uint64_t code, const struct predicate* pred)
+{
+	if(!is_possible_booths(code, pred))
+		return NO;
+	for(int i=0 ; i<pred->n_ceremony ; i++) /* The positions that differ from the ceremony */
+		if(popcount(nonzero_nibbles(code ^ pred->cer_code[i])) != pred->cer_differ[i])
+			return NO;
+	return YES;
+}
+
+/* Returns the mask of the 4 packed arrangements codes[0..3] still possible knowing all events of pred
+	(bit i for codes[i]); with AVX2, the ceremonies are tested on the 4 arrangements at once
+*/
+int possible_mask4(const uint64_t* codes, const struct predicate* pred)
+{
+	int i, mask = 0;
+	for(i=0 ; i<4 ; i++)
+		if(is_possible_booths(codes[i], pred))
+			mask |= 1 << i;
+#ifdef __AVX2__
+	const __m256i v = _mm256_loadu_si256((const __m256i*)codes);
+	const __m256i low = _mm256_set1_epi64x((long long)NIBBLES_LOW);
+	const __m256i low4 = _mm256_set1_epi8(0x0F);
+	for(i=0 ; i<pred->n_ceremony && mask ; i++) {
+		__m256i x = _mm256_xor_si256(v, _mm256_set1_epi64x((long long)pred->cer_code[i]));
+		x = _mm256_or_si256(x, _mm256_srli_epi64(x, 1));
+		x = _mm256_or_si256(x, _mm256_srli_epi64(x, 2));
+		x = _mm256_and_si256(x, low); /* Bit 4*j set if position j differs */
+		x = _mm256_add_epi8(_mm256_and_si256(x, low4), _mm256_and_si256(_mm256_srli_epi64(x, 4), low4));
+		x = _mm256_sad_epu8(x, _mm256_setzero_si256()); /* Number of positions that differ, in each 64 bits */
+		x = _mm256_cmpeq_epi64(x, _mm256_set1_epi64x(pred->cer_differ[i]));
+		mask &= _mm256_movemask_pd(_mm256_castsi256_pd(x));
+	}
+#else
+	for(i=0 ; i<4 ; i++)
+		if(((mask >> i) & 1) && !is_possible_all(codes[i], pred))
+			mask &= ~(1 << i);
+#endif
+	return mask;
+}
+
+/*
+	Instrumentation (option --stats FILE).
+	Each review of the arrangements, each print and each lineup writes one record to stats_file, one JSON object by line :
+	"record" is "review", "print" or "lineup", "label" the last title, "engine" the way the arrangements are reviewed or counted,
+	"wall_s" and "cpu_s" the wall time and the processor time of all threads (so cpu_s / wall_s shows the use of the threads),
+	"peak_kb" the peak memory of the process, and for a review, "tested" the arrangements tested
+	(the list of the possible ones, or the words of the bitset with a possible one, see sweep_chunk()),
+	"before" and "after" the possible arrangements, and "eliminated" the part of the possible ones eliminated;
+	for a print counted by dynamic programming, "states" the states reviewed (see count_dp()),
+	and for a "lineup" record, "arrangements" and "scored" the arrangements and the lineups scored (see search_lineup()).
+	With --progress, the long sweeps also show their progress on stderr (see run_worker()).
+*/
+FILE* stats_file = NULL;  /* Where the records are written (option --stats), or NULL */
+int show_progress = NO;   /* YES to show the progress of the sweeps on stderr (option --progress) */
+char stats_label[64] = ""; /* The last title, in the records */
+long long stats_tested = 0; /* The arrangements tested by all reviews so far (see apply_events()) */
+
+/* Returns the time in seconds */
+double now_seconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Returns the processor time used by all threads of the process, in seconds */
+double cpu_seconds()
+{
+	return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* Returns the peak memory of the process, in kB */
+long peak_memory_kb()
+{
+	struct rusage ru;
+	if(getrusage(RUSAGE_SELF, &ru))
+		return -1;
+	return ru.ru_maxrss;
+}
+
+/* Keeps the title of the next records (without the characters to escape in JSON) */
+void stats_title(const char* title)
+{
+	int i;
+	for(i=0 ; title[i] && i<(int)sizeof(stats_label)-1 ; i++)
+		stats_label[i] = (title[i] == '"' || title[i] == '\\' || (unsigned char)title[i] < ' ') ? '\'' : title[i];
+	stats_label[i] = 0;
+}
+
+/* Writes one record to stats_file (if any) : the common fields,
+	with the times since wall0 and cpu0, then the fields of fmt (starting with a comma)
+*/
+void stats_record(const char* record, const char* engine, double wall0, double cpu0, const char* fmt, ...)
+{
+	va_list args;
+	if(stats_file == NULL)
+		return;
+	fprintf(stats_file, "{\"record\":\"%s\",\"label\":\"%s\",\"engine\":\"%s\",\"wall_s\":%.6f,\"cpu_s\":%.6f,\"peak_kb\":%ld",
+		record, stats_label, engine, now_seconds() - wall0, cpu_seconds() - cpu0, peak_memory_kb());
+	va_start(args, fmt);
+	vfprintf(stats_file, fmt, args);
+	va_end(args);
+	fprintf(stats_file, "}\n");
+	fflush(stats_file);
+}
+
+/*
+	Parallel sweeps of is_right.
+	The words of is_right are cut into chunks of CHUNK_WORDS words (64 arrangements each).
+	Each thread starts with its own range of chunks, takes them from the front,
+	and when its range is empty, steals chunks from the back of the range of another thread.
+	Each thread fills its own changes of proba_right[] and nb_right, merged at the end,
+	so the result does not depend on the number of threads.
+*/
+
+int n_threads = 1; /* Number of threads for the sweeps (option --threads) */
+
+struct sweep; /* Forward declaration */
+
+/* One thread of a sweep */
+struct worker {
+	pthread_t thread;
+	pthread_mutex_t lock; /* Protects first, last and done */
+	int first, last;      /* The chunks still to do by this worker : first to last-1 */
+	int done;             /* The number of chunks done by this worker */
+	struct sweep* sweep;  /* The sweep this worker belongs to */
+	long long* proba_right; /* This worker's changes of the counts (size = n*(n-1), for each scenario), or NULL */
+	long long* nb_right;  /* This worker's number of possible arrangements (for each scenario) */
+	long long tested;     /* This worker's number of arrangements tested (without scenarios) */
+};
+
+/* A sweep of all arrangements of is_right */
+struct sweep {
+	int n;                   /* Number of positions */
+	struct bitset* is_right; /* The possible arrangements */
+	const struct predicate* pred; /* The events to apply, or NULL */
+	int n_scen;              /* Number of scenarios reviewed at once (see scenario_chunk()), or 0 */
+	struct bitset** scen_right; /* The possible arrangements of each scenario (size = n_scen) */
+	const struct predicate* scen_pred; /* The events of each scenario (size = n_scen) */
+	int n_chunks;            /* Number of chunks */
+	int n_workers;           /* Number of workers */
+	struct worker* workers;  /* The workers (size = n_workers) */
+	long long tested;        /* Number of arrangements tested (without scenarios), set by run_workers() */
+};
+
+/* Reviews the arrangements of one chunk, counts the possible ones in nb_right, and returns the number tested
+	(the ones of the words with a possible arrangement, generated one by one) :
+	with pred, applies it, and subtracts the arrangements it eliminates from proba_right[] (if not NULL),
+	without pred, adds the possible arrangements to proba_right[] (if not NULL)
+	The matches of the ceremonies are counted once at the start of each run of arrangements,
+	then updated with the 2 positions exchanged at each step (see compile_events() and next_ranked()),
+	or with more than 16 ceremonies, tested with is_possible_all().
+*/
+long long sweep_chunk(int n, struct bitset* is_right, const struct predicate* pred, int chunk, long long* proba_right, long long* nb_right)
+{
+	int b, pos;
+	long long w, tested = 0;
+	int* ta;
+	struct ranked_gen g;
+	const long long w_end = (long long)(chunk+1)*CHUNK_WORDS < is_right->n_words ? (long long)(chunk+1)*CHUNK_WORDS : is_right->n_words;
+	const int counted = pred != NULL && pred->cer_counted;
+	const uint64_t* hits = pred != NULL ? pred->cer_hits : NULL;
+	uint64_t matches = 0;
+	g.rank = g.last = -1;
+	for(w=(long long)chunk*CHUNK_WORDS ; w<w_end ; w++) {
+		uint64_t word = is_right->words[w];
+		const int size = bitset_word_size(is_right, w);
+		if(word == 0) /* No possible arrangement in this block : no test */
+			continue;
+		if(g.rank != is_right->first + 64*w) /* Jump over the previous blocks */
+			init_ranked(&g, n, is_right->first + 64*w, is_right->first + is_right->n_bits);
+		tested += size;
+		for(b=0 ; b<size ; b++) {
+			ta = next_ranked(&g);
+			if(counted && g.swap_a < 0) { /* First of a run : count the matches of the ceremonies */
+				matches = 0;
+				for(pos=0 ; pos<n ; pos++)
+					matches += hits[pos*16+ta[pos]];
+			} else if(counted) { /* No nibble goes below 0 or above 15 : the matches removed were counted */
+				const int pa = g.swap_a, pb = g.swap_b;
+				matches = matches - hits[pa*16+ta[pb]] - hits[pb*16+ta[pa]] + hits[pa*16+ta[pa]] + hits[pb*16+ta[pb]];
+			}
+			if(!((word >> b) & 1))
+				continue;
+			if(pred != NULL) {
+				if(counted ? is_possible_booths(g.code, pred) && matches == pred->cer_matches : is_possible_all(g.code, pred))
+					continue;
+				word &= ~((uint64_t)1 << b);
+			}
+			if(proba_right != NULL)
+				for(pos=0 ; pos<n ; pos++)
+					proba_right[ta[pos]*n+pos] += (pred != NULL) ? -1 : 1; /* ta[pos] is elt */
+		}
+		is_right->words[w] = word;
+		*nb_right += popcount(word);
+	}
+	return tested;
+}
+
+/* Reviews the arrangements of one chunk for the n_scen scenarios of sw at once (see run_scenarios()) :
+	each arrangement is generated once, and tested with the events of each scenario it is still possible for.
+	The ones still possible are added to proba_right[k*n*(n-1) + elt*n+pos] (if not NULL) and counted in nb_right[k],
+	for the scenario k. The matches of the ceremonies are counted as in sweep_chunk(), for each scenario,
+	and counted again after the arrangements impossible for all scenarios (not generated one by one).
+*/
+#define MAX_SCENARIOS 64 /* Max number of scenarios reviewed at once */
+void scenario_chunk(const struct sweep* sw, int chunk, long long* proba_right, long long* nb_right)
+{
+	int b, k, pos;
+	long long w;
+	int* ta;
+	struct ranked_gen g;
+	uint64_t words[MAX_SCENARIOS], matches[MAX_SCENARIOS];
+	const int n = sw->n, nsq = n * (n-1), n_scen = sw->n_scen;
+	const struct bitset* bs = sw->scen_right[0]; /* All have the same size */
+	const long long w_end = (long long)(chunk+1)*CHUNK_WORDS < bs->n_words ? (long long)(chunk+1)*CHUNK_WORDS : bs->n_words;
+	int stale = YES; /* YES if matches[] are not the ones of the last arrangement generated */
+	g.rank = g.last = -1;
+	for(w=(long long)chunk*CHUNK_WORDS ; w<w_end ; w++) {
+		uint64_t any = 0;
+		const int size = bitset_word_size(bs, w);
+		for(k=0 ; k<n_scen ; k++)
+			any |= words[k] = sw->scen_right[k]->words[w];
+		if(any == 0) { /* Impossible for all scenarios : no test */
+			stale = YES;
+			continue;
+		}
+		if(g.rank != bs->first + 64*w) { /* Jump over the previous blocks */
+			init_ranked(&g, n, bs->first + 64*w, bs->first + bs->n_bits);
+			stale = YES;
+		}
+		for(b=0 ; b<size ; b++) {
+			ta = next_ranked(&g);
+			if(!((any >> b) & 1)) {
+				stale = YES;
+				continue;
+			}
+			for(k=0 ; k<n_scen ; k++) {
+				const uint64_t* hits = sw->scen_pred[k].cer_hits;
+				if(stale || g.swap_a < 0) {
+					matches[k] = 0;
+					for(pos=0 ; pos<n ; pos++)
+						matches[k] += hits[pos*16+ta[pos]];
+				} else {
+					const int pa = g.swap_a, pb = g.swap_b;
+					matches[k] = matches[k] - hits[pa*16+ta[pb]] - hits[pb*16+ta[pa]] + hits[pa*16+ta[pa]] + hits[pb*16+ta[pb]];
+				}
+			}
+			stale = NO;
+			for(k=0 ; k<n_scen ; k++) {
+				const struct predicate* pred = &sw->scen_pred[k];
+				if(!((words[k] >> b) & 1))
+					continue;
+				if(pred->cer_counted ? !is_possible_booths(g.code, pred) || matches[k] != pred->cer_matches : !is_possible_all(g.code, pred)) {
+					words[k] &= ~((uint64_t)1 << b);
+					continue;
+				}
+				if(proba_right != NULL)
+					for(pos=0 ; pos<n ; pos++)
+						proba_right[k*nsq + ta[pos]*n+pos]++;
+			}
+		}
+		for(k=0 ; k<n_scen ; k++) {
+			sw->scen_right[k]->words[w] = words[k];
+			nb_right[k] += popcount(words[k]);
+		}
+	}
+}
+
+/* Returns the next chunk for worker me, taken from its own range or stolen from another worker, or -1 if none */
+int take_chunk(struct worker* me)
+{
+	struct sweep* sw = me->sweep;
+	int chunk = -1;
+	pthread_mutex_lock(&me->lock);
+	if(me->first < me->last)
+		chunk = me->first++;
+	pthread_mutex_unlock(&me->lock);
+	for(int i=1 ; chunk < 0 && i<sw->n_workers ; i++) { /* Steal from the others */
+		struct worker* victim = &sw->workers[(me - sw->workers + i) % sw->n_workers];
+		pthread_mutex_lock(&victim->lock);
+		if(victim->first < victim->last)
+			chunk = --victim->last;
+		pthread_mutex_unlock(&victim->lock);
+	}
+	return chunk;
+}
+
+/* Returns the number of chunks done by all workers of sw */
+int chunks_done(struct sweep* sw)
+{
+	int i, done = 0;
+	for(i=0 ; i<sw->n_workers ; i++) {
+		pthread_mutex_lock(&sw->workers[i].lock);
+		done += sw->workers[i].done;
+		pthread_mutex_unlock(&sw->workers[i].lock);
+	}
+	return done;
+}
+
+/* Main function of a worker
+	With show_progress, the worker 0 (the current thread) shows the progress of the sweep every PROGRESS_DELAY seconds
+*/
+#define PROGRESS_DELAY 0.5
+void* run_worker(void* arg)
+{
+	struct worker* me = (struct worker*)arg;
+	struct sweep* sw = me->sweep;
+	const int report = show_progress && me == sw->workers;
+	double last = report ? now_seconds() : 0;
+	int chunk;
+	while((chunk = take_chunk(me)) >= 0) {
+		if(sw->n_scen > 0)
+			scenario_chunk(sw, chunk, me->proba_right, me->nb_right);
+		else
+			me->tested += sweep_chunk(sw->n, sw->is_right, sw->pred, chunk, me->proba_right, me->nb_right);
+		pthread_mutex_lock(&me->lock);
+		me->done++;
+		pthread_mutex_unlock(&me->lock);
+		if(report && now_seconds() - last >= PROGRESS_DELAY) {
+			const int done = chunks_done(sw);
+			fprintf(stderr, "\rsweep : %3d%% (%d / %d chunks, %d threads)", 100 * done / sw->n_chunks, done, sw->n_chunks, sw->n_workers);
+			fflush(stderr);
+			last = now_seconds();
+		}
+	}
+	return NULL;
+}
+
+/* Runs the sweep sw with n_threads threads (the current one and n_threads-1 more) :
+	the results of the workers are added to proba_right[] (if not NULL) and nb_right[],
+	n*(n-1) counts and 1 number for each scenario (or just one set without scenarios)
+*/
+void run_workers(struct sweep* sw, long long* proba_right, long long* nb_right)
+{
+	int i, k;
+	const int n_sets = sw->n_scen > 0 ? sw->n_scen : 1;
+	const int nsq = sw->n * (sw->n-1) * n_sets;
+	const struct bitset* bs = sw->n_scen > 0 ? sw->scen_right[0] : sw->is_right;
+	sw->n_chunks = (int)((bs->n_words + CHUNK_WORDS-1) / CHUNK_WORDS);
+	sw->n_workers = n_threads < sw->n_chunks ? n_threads : sw->n_chunks;
+	if(sw->n_workers < 1)
+		sw->n_workers = 1;
+	sw->workers = (struct worker*)malloc(sw->n_workers * sizeof(struct worker));
+	if(!sw->workers) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	for(i=0 ; i<sw->n_workers ; i++) {
+		struct worker* wk = &sw->workers[i];
+		pthread_mutex_init(&wk->lock, NULL);
+		wk->first = (int)((long long)sw->n_chunks * i / sw->n_workers);
+		wk->last = (int)((long long)sw->n_chunks * (i+1) / sw->n_workers);
+		wk->sweep = sw;
+		wk->done = 0;
+		wk->tested = 0;
+		wk->nb_right = new_counts(n_sets);
+		wk->proba_right = NULL;
+		if(proba_right != NULL) {
+			wk->proba_right = new_counts(nsq);
+		}
+	}
+	for(i=1 ; i<sw->n_workers ; i++) /* The current thread is the worker 0 */
+		if(pthread_create(&sw->workers[i].thread, NULL, run_worker, &sw->workers[i])) {
+			fprintf(stderr, "error : pthread_create()\n");
+			exit(1);
+		}
+	run_worker(&sw->workers[0]);
+	sw->tested = 0;
+	for(i=0 ; i<sw->n_workers ; i++) { /* Merge the results */
+		struct worker* wk = &sw->workers[i];
+		if(i > 0)
+			pthread_join(wk->thread, NULL);
+		pthread_mutex_destroy(&wk->lock);
+		sw->tested += wk->tested;
+		for(k=0 ; k<n_sets ; k++)
+			nb_right[k] += wk->nb_right[k];
+		free(wk->nb_right);
+		if(proba_right != NULL) {
+			for(k=0 ; k<nsq ; k++)
+				proba_right[k] += wk->proba_right[k];
+			free(wk->proba_right);
+		}
+	}
+	free(sw->workers);
+	if(show_progress) /* Clear the progress */
+		fprintf(stderr, "\r%60s\r", "");
+}
+
+/* Reviews all arrangements of is_right with n_threads threads (see sweep_chunk()) :
+	applies pred (if not NULL), updates proba_right[] (if not NULL), adds the number of arrangements tested
+	to *tested (if not NULL), and returns the number of possible arrangements
+*/
+long long run_sweep(int n, struct bitset* is_right, const struct predicate* pred, long long* proba_right, long long* tested)
+{
+	long long nb_right = 0;
+	struct sweep sw;
+	sw.n = n;
+	sw.is_right = is_right;
+	sw.pred = pred;
+	sw.n_scen = 0;
+	run_workers(&sw, proba_right, &nb_right);
+	if(tested != NULL)
+		*tested += sw.tested;
+	return nb_right;
+}
+
+/* Reviews all arrangements of the spill in with n_threads threads, a window at a time (see run_sweep()),
+	the next window being read by another thread meanwhile :
+	applies pred, updates proba_right[] (if not NULL), sets *nb_right to the number of possible arrangements,
+	adds the number of arrangements tested to *tested, and returns the new spill
+*/
+struct spill* spill_sweep(int n, const struct spill* in, const struct predicate* pred, long long* proba_right, long long* nb_right, long long* tested)
+{
+	struct spill* out = new_spill(in->n_bits);
+	struct bitset* window[2] = {new_window(), new_window()};
+	struct spill_reader rd;
+	const long long n_win = spill_windows(in);
+	const int progress = show_progress;
+	double last = now_seconds();
+	show_progress = NO; /* The progress of the windows, not of each sweep */
+	*nb_right = 0;
+	spill_read(in, 0, window[0]);
+	for(long long win=0 ; win<n_win ; win++) {
+		struct bitset* bs = window[win % 2];
+		rd.sp = in;
+		rd.win = win+1;
+		rd.bs = window[(win+1) % 2];
+		if(win+1 < n_win && pthread_create(&rd.thread, NULL, run_spill_reader, &rd)) {
+			fprintf(stderr, "error : pthread_create()\n");
+			exit(1);
+		}
+		*nb_right += run_sweep(n, bs, pred, proba_right, tested);
+		spill_write(out, bs->words, bs->n_words);
+		if(win+1 < n_win)
+			pthread_join(rd.thread, NULL);
+		if(progress && now_seconds() - last >= PROGRESS_DELAY) {
+			fprintf(stderr, "\rspill : %3d%% (%lld / %lld windows, %lld possible)", (int)(100 * (win+1) / n_win), win+1, n_win, *nb_right);
+			fflush(stderr);
+			last = now_seconds();
+		}
+	}
+	show_progress = progress;
+	if(show_progress)
+		fprintf(stderr, "\r%70s\r", "");
+	free_bitset(window[0]);
+	free_bitset(window[1]);
+	return out;
+}
+
+/* Prints names of m elements and n positions
+	gender == 0 -> elements are boys, positions are girls
+	gender == 1 -> elements are girls, positions are boys
+*/
+void print_names(int n, int m, int gender, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	int i;
+	printf("The %s are :\n", (gender?"boys":"girls"));
+	for(i=0 ; i<n ; i++)
+		fprintf(stdout, "\tpos=%d\t%s\n", i, npos[i]);
+	printf("\n");
+	printf("The %s are :\n", (gender?"girls":"boys"));
+	for(i=0 ; i<m ; i++)
+		fprintf(stdout, "\telt=%d\t%s\n", i, nelt[i]);
+	printf("\n");
+}
+
+/* Prints the current state of is_right[]
+	(This is for control purpose)
+*/
+void print_is_right(int n, const struct right* right)
+{
+	long long i;
+	int* ta;
+	if(right->surv != NULL) { /* Only the possible arrangements are known */
+		int t[MAX_N];
+		printf("Current possible arrangements :\n");
+		for(i=0 ; i<right->nb_right ; i++) {
+			unpack_arrangement(right->surv[i], t, n);
+			fprintf(stdout, "yes\t");
+			print_array(t, n);
+		}
+		printf("\n");
+		return;
+	}
+	struct ranked_gen g;
+	struct bitset* bs = right->spill ? new_window() : right->is_right;
+	const long long n_win = right->spill ? spill_windows(right->spill) : 1;
+	printf("Current is_right[] :\n");
+	for(long long win=0 ; win<n_win ; win++) {
+		if(right->spill)
+			spill_read(right->spill, win, bs);
+		init_ranked(&g, n, bs->first, bs->first + bs->n_bits);
+		for(i=0 ; (ta=next_ranked(&g)) != NULL ; i++) {
+			fprintf(stdout, "%s\t", (bs->words[i/64] >> (i%64)) & 1 ? "yes" : "no ");
+			print_array(ta, n);
+		}
+	}
+	if(right->spill)
+		free_bitset(bs);
+	printf("\n");
+}
+
+/* Prints the probability of having each of the m elements to each of the n positions,
+	knowing nb_right possible arrangements among n_arr, with elt at pos in proba_right[elt*n+pos] of them
+*/
+void print_proba(int n, int m, long long nb_right, long long n_arr, const long long* proba_right, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	int pos, elt;
+	fprintf(stdout, "Number of possible arrangements : %lld / %lld\n", nb_right, n_arr);
+	fprintf(stdout, ".\t."); /* First header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\tpos=%d", pos);
+	fprintf(stdout, "\n");
+	fprintf(stdout, ".\t."); /* Second header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\t%s", npos[pos]);
+	fprintf(stdout, "\n");
+	for(elt=0 ; elt<m ; elt++) { /* Content */
+		fprintf(stdout, "elt=%d", elt);
+		fprintf(stdout, "\t%s", nelt[elt]);
+		for(pos=0 ; pos<n ; pos++) {
+			if(nb_right == 0)
+				fprintf(stdout, "\t X    ");
+			else if(proba_right[elt*n+pos] == 0)
+				fprintf(stdout, "\t  0%% ");
+			else if(proba_right[elt*n+pos] == nb_right)
+				fprintf(stdout, "\t100%% ");
+			else
+				fprintf(stdout, "\t%4.1f%%", 100*(double)proba_right[elt*n+pos]/nb_right);
+		}
+		fprintf(stdout, "\n");
+	}
+	fprintf(stdout, "\n");
+
+	fflush(stdout);
+}
+
+/* Prints the expected information (in bits) given by the truth booth of each element with each position,
+	knowing nb_right possible arrangements, with elt at pos in proba_right[elt*n+pos] of them,
+	and the best truth booth.
+	A truth booth with a probability p answers yes with probability p, so it gives
+	-p*log2(p) - (1-p)*log2(1-p) bits (the expected decrease of log2(nb_right)) :
+	the best one is the closest to 50%, and the counts already known are enough.
+*/
+void print_booth_gains(int n, int m, long long nb_right, const long long* proba_right, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	int pos, elt, best_elt = -1, best_pos = -1;
+	double best = 0;
+	fprintf(stdout, "Expected information of each truth booth (bits) :\n");
+	fprintf(stdout, ".\t."); /* First header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\tpos=%d", pos);
+	fprintf(stdout, "\n");
+	fprintf(stdout, ".\t."); /* Second header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\t%s", npos[pos]);
+	fprintf(stdout, "\n");
+	for(elt=0 ; elt<m ; elt++) { /* Content */
+		fprintf(stdout, "elt=%d", elt);
+		fprintf(stdout, "\t%s", nelt[elt]);
+		for(pos=0 ; pos<n ; pos++) {
+			const double p = nb_right ? (double)proba_right[elt*n+pos] / nb_right : 0;
+			const double gain = (p <= 0 || p >= 1) ? 0 : -p*log2(p) - (1-p)*log2(1-p);
+			if(gain > best) {
+				best = gain;
+				best_elt = elt;
+				best_pos = pos;
+			}
+			fprintf(stdout, gain > 0 ? "\t%5.3f" : "\t  -  ", gain);
+		}
+		fprintf(stdout, "\n");
+	}
+	if(best_elt < 0)
+		fprintf(stdout, "No truth booth gives information\n\n");
+	else
+		fprintf(stdout, "Best truth booth : %s with %s (%4.1f%%, %5.3f bits)\n\n", nelt[best_elt], npos[best_pos],
+			100*(double)proba_right[best_elt*n+best_pos]/nb_right, best);
+	fflush(stdout);
+}
+
+/* Prints probability of having each element to each position */
+void print_proba_right(int n, const struct right* right, long long nb_right, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	/* Prints proba_right[], always up to date */
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	print_proba(n, n-1, nb_right, right->n_arr, right->proba_right, nelt, npos);
+	stats_record("print", right->surv != NULL ? "list" : right->spill != NULL ? "spill" : "bitset", wall0, cpu0, ",\"possible\":%lld", nb_right);
+}
+
+/* Packs the arrangements of the bitset bs into codes[], and returns their number */
+long long bitset_codes(int n, const struct bitset* bs, uint64_t* codes)
+{
+	int ta[MAX_N];
+	long long k = 0;
+	for(long long w=0 ; w<bs->n_words ; w++)
+		for(int b=0 ; b<64 ; b++)
+			if((bs->words[w] >> b) & 1) {
+				unrank_arrangement(n, bs->first + 64*w+b, ta);
+				codes[k++] = pack_arrangement(ta, n);
+			}
+	return k;
+}
+
+/* Updates right knowing the n_ev events evs[], all applied in one review,
+	and returns the new value for nb_right
+	In the same review, the arrangements eliminated are subtracted from right->proba_right[],
+	so print_proba_right() does not need to review them again.
+*/
+long long apply_events(int n, struct right* right, const struct event* evs, int n_ev)
+{
+	int pos;
+	long long i, nb_right = 0, tested = 0;
+	struct predicate pred;
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	const long long before = right->nb_right;
+	const char* engine = right->surv != NULL ? "list" : right->spill != NULL ? "spill" : "bitset";
+	compile_events(n, &pred, evs, n_ev);
+	if(right->surv != NULL) { /* Review only the possible arrangements (by 4), and keep the ones still possible */
+		int ta[MAX_N];
+		uint64_t codes[4];
+		tested = right->nb_right;
+		for(i=0 ; i<right->nb_right ; i+=4) {
+			int k, mask;
+			for(k=0 ; k<4 ; k++)
+				codes[k] = i+k < right->nb_right ? right->surv[i+k] : 0;
+			mask = possible_mask4(codes, &pred);
+			if(right->nb_right - i < 4) /* Ignore the completion of the last 4 */
+				mask &= (1 << (int)(right->nb_right - i)) - 1;
+			for(k=0 ; k<4 && i+k<right->nb_right ; k++)
+				if((mask >> k) & 1)
+					right->surv[nb_right++] = codes[k];
+				else {
+					unpack_arrangement(codes[k], ta, n);
+					for(pos=0 ; pos<n ; pos++)
+						right->proba_right[ta[pos]*n+pos]--;
+				}
+		}
+	} else if(right->spill != NULL) { /* Review all arrangements from the disk, to a new file */
+		struct spill* old = right->spill;
+		right->spill = spill_sweep(n, old, &pred, right->proba_right, &nb_right, &tested);
+		if(!old->kept)
+			free_spill(old);
+		if(nb_right <= right->n_arr / SURV_RATIO && nb_right <= SPILL_LIST) { /* Few enough : back in memory, in the list */
+			struct bitset* bs = new_window();
+			long long k = 0;
+			right->surv = new_codes(nb_right);
+			for(long long win=0 ; win<spill_windows(right->spill) ; win++) {
+				spill_read(right->spill, win, bs);
+				k += bitset_codes(n, bs, right->surv + k);
+			}
+			free_bitset(bs);
+			free_spill(right->spill);
+			right->spill = NULL;
+		}
+	} else { /* Review all arrangements */
+		struct bitset* is_right = right->is_right;
+		nb_right = run_sweep(n, is_right, &pred, right->proba_right, &tested);
+		if(nb_right <= right->n_arr / SURV_RATIO) { /* Few enough : switch to the list */
+			right->surv = new_codes(nb_right);
+			bitset_codes(n, is_right, right->surv);
+			free_bitset(is_right);
+			right->is_right = NULL;
+		}
+	}
+	free_predicate(&pred);
+	right->nb_right = nb_right;
+	stats_tested += tested;
+	stats_record("review", engine, wall0, cpu0, ",\"events\":%d,\"tested\":%lld,\"before\":%lld,\"after\":%lld,\"eliminated\":%.6f",
+		n_ev, tested, before, nb_right, before ? (double)(before - nb_right) / before : 0.);
+	return nb_right;
+}
+
+/* Updates right knowing the event ev,
+	and returns the new value for nb_right
+*/
+long long apply_event(int n, struct right* right, const struct event* ev)
+{
+	return apply_events(n, right, ev, 1);
+}
+
+/* Prints the event ev */
+void print_event(int n, const struct event* ev, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	int i;
+	switch(ev->type) {
+	case EV_COUPLE:
+		fprintf(stdout, "%s %s in couple with %s\n",
+			nelt[ev->elt],
+			ev->couple ? "is" : "is not",
+			npos[ev->pos]);
+		break;
+	case EV_CEREMONY:
+		fprintf(stdout, "A new ceremony :\n");
+		for(i=0 ; i<n ; i++)
+			if(ev->a_elt[i] == -1)
+				printf("(pos=%d) %s stays alone\n", i, npos[i]);
+			else
+				printf("(pos=%d,elt=%d) %s with %s\n", i, ev->a_elt[i], npos[i], nelt[ev->a_elt[i]]);
+		printf("We have %d matches\n", ev->matches);
+		break;
+	case EV_DOUBLON:
+		fprintf(stdout, "We know who is the doublon : %s\n", npos[ev->pos]);
+		break;
+	}
+}
+
+/* Updates right knowing the n_ev events evs[] (for example all events of a week),
+	with one review of the arrangements, and returns the new value for nb_right
+*/
+long long add_events(int n, struct right* right, const struct event* evs, int n_ev, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	for(int i=0 ; i<n_ev ; i++)
+		print_event(n, &evs[i], nelt, npos);
+	return apply_events(n, right, evs, n_ev);
+}
+
+/* Updates right knowing that elt is associated (or not) to pos,
+	and returns the new value for nb_right
+	if couple == 1 then it's a couple
+	if couple == 0 then it's not a couple
+*/
+long long add_new_couple(int n, struct right* right, int couple, int elt, int pos, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	struct event ev;
+	ev.type = EV_COUPLE;
+	ev.couple = couple;
+	ev.elt = elt;
+	ev.pos = pos;
+	return add_events(n, right, &ev, 1, nelt, npos);
+}
+
+/* Updates right knowing a ceremony;
+	we have a set of n-1 couples, and the number of matches (the right couples),
+	and returns the new value for nb_right
+	a_elt[] has a size of n, but only n-1 positions are experimented (one position stays alone)
+	for the alone position, a_elt[] is -1
+*/
+long long add_ceremony(int n, struct right* right, const int* a_elt, int matches, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	struct event ev;
+	ev.type = EV_CEREMONY;
+	ev.matches = matches;
+	for(int i=0 ; i<n ; i++)
+		ev.a_elt[i] = a_elt[i];
+	return add_events(n, right, &ev, 1, nelt, npos);
+}
+
+/* Updates right knowing that pos is the doublon
+	and returns the new value for nb_right
+*/
+long long add_the_doublon(int n, struct right* right, int pos, const char npos[][MAX_NAME+1])
+{
+	struct event ev;
+	fprintf(stdout, "We know who is the doublon : %s\n", npos[pos]);
+	ev.type = EV_DOUBLON;
+	ev.pos = pos;
+	return apply_event(n, right, &ev);
+}
+
+/*
+	Undo : when events are applied, the arrangements they eliminate are kept in a delta,
+	so the events can be cancelled later without any review.
+*/
+struct delta {
+	int n_ev;                  /* Number of events applied */
+	long long nb_right;        /* nb_right before the events */
+	long long* proba_right;    /* proba_right[] before the events, or NULL */
+	struct bitset* old_bitset; /* The whole is_right before the events (if most words changed, or the events switched to the list), or NULL */
+	struct spill* old_spill;   /* The spill before the events (its file is kept, see spill_sweep()), or NULL */
+	long long n_changed;       /* Number of words of is_right changed by the events (if old_bitset is NULL) */
+	long long* changed;        /* Their index */
+	uint64_t* old_words;       /* Their value before the events */
+	long long n_removed;       /* Number of arrangements removed from surv[] by the events */
+	long long* removed_at;     /* Their index in surv[] before the events, increasing */
+	uint64_t* removed;         /* Their codes */
+};
+
+/* Frees the delta d */
+void free_delta(struct delta* d)
+{
+	if(!d)
+		return;
+	free(d->proba_right);
+	free_bitset(d->old_bitset);
+	free_spill(d->old_spill);
+	free(d->changed);
+	free(d->old_words);
+	free(d->removed_at);
+	free(d->removed);
+	free(d);
+}
+
+/* Same as apply_events(), but returns the delta to cancel the events with undo_events() */
+struct delta* apply_events_undoable(int n, struct right* right, const struct event* evs, int n_ev)
+{
+	long long i, k;
+	const int nsq = n * (n-1);
+	struct delta* d = (struct delta*)calloc(1, sizeof(struct delta));
+	if(!d) {
+		fprintf(stderr, "error : calloc()\n");
+		exit(1);
+	}
+	d->n_ev = n_ev;
+	d->nb_right = right->nb_right;
+	if(right->proba_right != NULL) {
+		d->proba_right = new_counts(nsq);
+		memcpy(d->proba_right, right->proba_right, nsq * sizeof(long long));
+	}
+	if(right->surv != NULL) { /* The list keeps its order : the removed ones are found by a merge */
+		uint64_t* old = new_codes(d->nb_right);
+		memcpy(old, right->surv, d->nb_right * sizeof(uint64_t));
+		apply_events(n, right, evs, n_ev);
+		d->removed_at = new_counts(d->nb_right - right->nb_right);
+		d->removed = new_codes(d->nb_right - right->nb_right);
+		for(i=0, k=0 ; i<d->nb_right ; i++)
+			if(k < right->nb_right && right->surv[k] == old[i])
+				k++;
+			else {
+				d->removed_at[d->n_removed] = i;
+				d->removed[d->n_removed++] = old[i];
+			}
+		free(old);
+	} else if(right->spill != NULL) { /* Each review writes a new file : keep the old one */
+		d->old_spill = right->spill;
+		d->old_spill->kept = YES;
+		apply_events(n, right, evs, n_ev);
+	} else { /* Keep the words changed, or the whole bitset if most of them changed */
+		const struct bitset* is_right = right->is_right;
+		d->old_bitset = new_bitset(is_right->n_bits);
+		memcpy(d->old_bitset->words, is_right->words, is_right->n_words * sizeof(uint64_t));
+		apply_events(n, right, evs, n_ev);
+		if(right->is_right != NULL) {
+			const uint64_t* old = d->old_bitset->words;
+			const uint64_t* words = right->is_right->words;
+			for(i=0 ; i<right->is_right->n_words ; i++)
+				d->n_changed += (old[i] != words[i]);
+			if(d->n_changed < right->is_right->n_words / 2) {
+				d->changed = new_counts(d->n_changed);
+				d->old_words = new_codes(d->n_changed);
+				for(i=0, k=0 ; i<right->is_right->n_words ; i++)
+					if(old[i] != words[i]) {
+						d->changed[k] = i;
+						d->old_words[k++] = old[i];
+					}
+				free_bitset(d->old_bitset);
+				d->old_bitset = NULL;
+			}
+		}
+	}
+	return d;
+}
+
+/* Cancels the events applied by apply_events_undoable(), and frees the delta d
+	returns the new value for nb_right
+*/
+long long undo_events(struct right* right, struct delta* d)
+{
+	long long i, k;
+	if(d->old_bitset != NULL) {
+		free(right->surv);
+		right->surv = NULL;
+		free_bitset(right->is_right);
+		right->is_right = d->old_bitset;
+		d->old_bitset = NULL;
+	} else if(d->old_spill != NULL) {
+		free(right->surv);
+		right->surv = NULL;
+		free_spill(right->spill);
+		right->spill = d->old_spill;
+		right->spill->kept = NO;
+		d->old_spill = NULL;
+	} else if(right->surv != NULL) { /* Merge the removed ones back at their place */
+		uint64_t* surv = new_codes(d->nb_right);
+		for(i=0, k=0 ; i<d->nb_right ; i++)
+			if(k < d->n_removed && d->removed_at[k] == i)
+				surv[i] = d->removed[k++];
+			else
+				surv[i] = right->surv[i-k];
+		free(right->surv);
+		right->surv = surv;
+	} else {
+		for(i=0 ; i<d->n_changed ; i++)
+			right->is_right->words[d->changed[i]] = d->old_words[i];
+	}
+	free(right->proba_right);
+	right->proba_right = d->proba_right;
+	d->proba_right = NULL;
+	right->nb_right = d->nb_right;
+	free_delta(d);
+	return right->nb_right;
+}
+
+/*
+	Ceremony optimizer : searches the lineup of the next ceremony that gives the most information,
+	that is the largest entropy of its number of matches among the possible arrangements.
+	The possible arrangements are the list surv[], or a regular sample of is_right (LINEUP_SAMPLE of them).
+	Each thread runs a simulated annealing over the lineups (a move swaps the elements of two positions),
+	and scores LINEUP_BATCH neighbours in one pass over the arrangements, until the time budget is over.
+*/
+#define LINEUP_SAMPLE 65536 /* Max number of arrangements to score the lineups */
+#define LINEUP_BATCH  16    /* Number of lineups scored in one pass */
+#define LINEUP_TEMP   0.05  /* Temperature (bits) of the annealing at the beginning, down to 0 at the end */
+
+double time_budget = 2; /* Time of the searches in seconds, lineups and samples (option --budget) */
+
+/* Returns the possible arrangements of right, packed (to free) : all of them, or a regular sample of max of them,
+	and sets *n_codes to their number
+*/
+uint64_t* sample_right(int n, const struct right* right, int max, int* n_codes)
+{
+	int b, k = 0, ta[MAX_N];
+	long long w, seen = 0;
+	const int n_sample = right->nb_right < max ? (int)right->nb_right : max;
+	uint64_t* codes = new_codes(n_sample);
+	if(right->surv != NULL && right->nb_right <= max)
+		memcpy(codes, right->surv, right->nb_right * sizeof(uint64_t));
+	else if(right->surv != NULL)
+		for(k=0 ; k<n_sample ; k++)
+			codes[k] = right->surv[(long long)k * right->nb_right / n_sample];
+	else { /* The arrangement number seen is taken when it reaches the next k * nb_right / n_sample */
+		struct bitset* bs = right->spill ? new_window() : right->is_right;
+		const long long n_win = right->spill ? spill_windows(right->spill) : 1;
+		for(long long win=0 ; win<n_win && k<n_sample ; win++) {
+			if(right->spill)
+				spill_read(right->spill, win, bs);
+			for(w=0 ; w<bs->n_words && k<n_sample ; w++) {
+				const uint64_t word = bs->words[w];
+				if(seen + popcount(word) <= (long long)k * right->nb_right / n_sample) {
+					seen += popcount(word);
+					continue;
+				}
+				for(b=0 ; b<64 && k<n_sample ; b++)
+					if((word >> b) & 1) {
+						if(seen == (long long)k * right->nb_right / n_sample) {
+							unrank_arrangement(n, bs->first + 64*w+b, ta);
+							codes[k++] = pack_arrangement(ta, n);
+						}
+						seen++;
+					}
+			}
+		}
+		if(right->spill)
+			free_bitset(bs);
+	}
+	*n_codes = n_sample;
+	return codes;
+}
+
+/* Packs the lineup a_elt[] of n positions like a ceremony (0xF for the alone position and beyond n) */
+uint64_t pack_lineup(const int* a_elt, int n)
+{
+	uint64_t code = ~(uint64_t)0;
+	for(int j=n-1 ; j>=0 ; j--)
+		code = (code << 4) | (uint64_t)(a_elt[j] & 0xF);
+	return code;
+}
+
+/* Scores the n_cand lineups cand[] (packed) on the n_codes arrangements codes[], in one pass :
+	gain[c] is the entropy (bits) of the number of matches of cand[c], and hist[c*(MAX_N+1)+m]
+	the number of arrangements with m matches
+*/
+void score_lineups(const uint64_t* codes, int n_codes, const uint64_t* cand, int n_cand, double* gain, int* hist)
+{
+	int i, c, m;
+	memset(hist, 0, n_cand * (MAX_N+1) * sizeof(int));
+	for(i=0 ; i<n_codes ; i++)
+		for(c=0 ; c<n_cand ; c++)
+			hist[c*(MAX_N+1) + 16 - popcount(nonzero_nibbles(codes[i] ^ cand[c]))]++;
+	for(c=0 ; c<n_cand ; c++) {
+		gain[c] = 0;
+		for(m=0 ; m<=MAX_N ; m++)
+			if(hist[c*(MAX_N+1)+m] > 0) {
+				const double p = (double)hist[c*(MAX_N+1)+m] / n_codes;
+				gain[c] -= p * log2(p);
+			}
+	}
+}
+
+/* One thread of the search of a lineup */
+struct lineup_search {
+	pthread_t thread;
+	int n;                  /* Number of positions */
+	const uint64_t* codes;  /* The possible arrangements (size = n_codes) */
+	int n_codes;
+	uint64_t seed;          /* The state of the random generator of this thread */
+	double budget;          /* Time of the search in seconds */
+	int best[MAX_N];        /* The best lineup found */
+	double best_gain;       /* Its entropy */
+	int best_hist[MAX_N+1]; /* Its number of arrangements by matches */
+	long long n_scored;     /* Number of lineups scored */
+};
+
+/* Returns a random number (xorshift64) */
+uint64_t next_random(uint64_t* seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 7;
+	*seed ^= *seed << 17;
+	return *seed;
+}
+
+/* Returns a position of the extra of the lineup a_elt[] (n positions, each of the n-1 elements at least once) :
+	the alone position, or one of the 2 positions of the doubled element, at random
+	A lineup can use an element twice and leave no position alone, as the real ceremonies often do.
+*/
+int lineup_extra(const int* a_elt, int n, uint64_t* seed)
+{
+	int i, j;
+	for(i=0 ; i<n ; i++) {
+		if(a_elt[i] < 0)
+			return i;
+		for(j=i+1 ; j<n ; j++)
+			if(a_elt[j] == a_elt[i])
+				return next_random(seed) % 2 ? i : j;
+	}
+	return 0;
+}
+
+/* Main function of a thread of the search : simulated annealing from a random lineup */
+void* run_lineup_search(void* arg)
+{
+	struct lineup_search* ls = (struct lineup_search*)arg;
+	const int n = ls->n;
+	int i, c, cur[MAX_N], next[LINEUP_BATCH][MAX_N];
+	int hist[LINEUP_BATCH*(MAX_N+1)];
+	uint64_t cand[LINEUP_BATCH];
+	double gain[LINEUP_BATCH], cur_gain;
+	const double start = now_seconds();
+	double elapsed = 0;
+
+	/* A random lineup : the n-1 elements, and one position alone */
+	for(i=0 ; i<n ; i++)
+		cur[i] = i < n-1 ? i : -1;
+	for(i=n-1 ; i>0 ; i--) {
+		const int j = (int)(next_random(&ls->seed) % (i+1));
+		const int t = cur[i];
+		cur[i] = cur[j];
+		cur[j] = t;
+	}
+	cand[0] = pack_lineup(cur, n);
+	score_lineups(ls->codes, ls->n_codes, cand, 1, &cur_gain, hist);
+	memcpy(ls->best, cur, sizeof(cur));
+	ls->best_gain = cur_gain;
+	memcpy(ls->best_hist, hist, sizeof(ls->best_hist));
+	ls->n_scored = 1;
+
+	while(elapsed < ls->budget) {
+		/* The neighbours : two positions swapped, or (1 in 4) the extra given to another element or left alone */
+		for(c=0 ; c<LINEUP_BATCH ; c++) {
+			memcpy(next[c], cur, sizeof(cur));
+			if(next_random(&ls->seed) % 4 == 0) {
+				const int p = lineup_extra(cur, n, &ls->seed);
+				int v = (int)(next_random(&ls->seed) % (n-1)) - 1; /* -1 to n-2, but not cur[p] */
+				v += (v >= cur[p]);
+				next[c][p] = v;
+			} else {
+				const int p = (int)(next_random(&ls->seed) % n);
+				const int q = (p + 1 + (int)(next_random(&ls->seed) % (n-1))) % n;
+				next[c][p] = cur[q];
+				next[c][q] = cur[p];
+			}
+			cand[c] = pack_lineup(next[c], n);
+		}
+		score_lineups(ls->codes, ls->n_codes, cand, LINEUP_BATCH, gain, hist);
+		ls->n_scored += LINEUP_BATCH;
+
+		/* Move to the best neighbour, always if it is better, or with a probability decreasing with the time */
+		for(i=0, c=1 ; c<LINEUP_BATCH ; c++)
+			if(gain[c] > gain[i])
+				i = c;
+		if(gain[i] > ls->best_gain) {
+			memcpy(ls->best, next[i], sizeof(cur));
+			ls->best_gain = gain[i];
+			memcpy(ls->best_hist, hist + i*(MAX_N+1), sizeof(ls->best_hist));
+		}
+		elapsed = now_seconds() - start;
+		const double temp = LINEUP_TEMP * (1 - elapsed / ls->budget);
+		if(gain[i] >= cur_gain || (temp > 0 && (double)(next_random(&ls->seed) % 1000000) / 1000000 < exp((gain[i] - cur_gain) / temp))) {
+			memcpy(cur, next[i], sizeof(cur));
+			cur_gain = gain[i];
+		}
+	}
+	return NULL;
+}
+
+/* Searches the lineup of the next ceremony with the largest entropy of its matches,
+	among the possible arrangements of right, with n_threads threads during budget seconds :
+	sets a_elt[] to the best lineup (-1 for the alone position), hist[] to its number of arrangements
+	by matches (size = MAX_N+1), *n_codes to the number of arrangements reviewed, *n_scored to the number of lineups scored,
+	and returns its entropy (bits)
+*/
+double search_lineup(int n, const struct right* right, double budget, int* a_elt, int* hist, int* n_codes, long long* n_scored)
+{
+	int i, best = 0;
+	uint64_t* codes = sample_right(n, right, LINEUP_SAMPLE, n_codes);
+	struct lineup_search* ls = (struct lineup_search*)malloc(n_threads * sizeof(struct lineup_search));
+	if(!ls) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	for(i=0 ; i<n_threads ; i++) {
+		ls[i].n = n;
+		ls[i].codes = codes;
+		ls[i].n_codes = *n_codes;
+		ls[i].seed = 0x9E3779B97F4A7C15ULL * (i+1);
+		ls[i].budget = budget;
+	}
+	for(i=1 ; i<n_threads ; i++) /* The current thread is the search 0 */
+		if(pthread_create(&ls[i].thread, NULL, run_lineup_search, &ls[i])) {
+			fprintf(stderr, "error : pthread_create()\n");
+			exit(1);
+		}
+	run_lineup_search(&ls[0]);
+	*n_scored = 0;
+	for(i=0 ; i<n_threads ; i++) {
+		if(i > 0)
+			pthread_join(ls[i].thread, NULL);
+		*n_scored += ls[i].n_scored;
+		if(ls[i].best_gain > ls[best].best_gain)
+			best = i;
+	}
+	memcpy(a_elt, ls[best].best, n * sizeof(int));
+	memcpy(hist, ls[best].best_hist, (MAX_N+1) * sizeof(int));
+	const double gain = ls[best].best_gain;
+	free(ls);
+	free(codes);
+	return gain;
+}
+
+/*
+	Counting by backtracking, with no review of all arrangements.
+	The arrangements are built position by position (the positions with a truth booth first),
+	and a branch is abandoned as soon as :
+		- an element is not allowed at a position (truth booths),
+		- more than n-m elements would be doubled,
+		- the elements at doublon positions could not all be doubled,
+		- a ceremony has too many matches, or not enough positions left to reach its matches.
+	So only the possible arrangements and their prefixes are reviewed, and n can go beyond 11.
+	Any shape of m elements in n positions (m <= n <= 2*m) is counted this way :
+	as each position filled is the first or the second of its element, the positions left are always
+	the elements unused plus the doubled ones still to come, so all elements are used at the end.
+*/
+struct backtrack {
+	int n;                  /* Number of positions */
+	int m;                  /* Number of elements */
+	int doubles;            /* Number of elements used twice : n-m */
+	int order[MAX_N];       /* The positions, in the order they are filled */
+	int allowed[MAX_N];     /* Bit elt of allowed[d] is set if elt is allowed at order[d] */
+	int is_doublon[MAX_N];  /* YES if order[d] is known as the doublon */
+	int n_cer;              /* Number of ceremonies */
+	int* cer_elt;           /* cer_elt[c*n+d] is the element tested at order[d] by ceremony c, or -1 */
+	int* cer_matches;       /* The number of matches of each ceremony */
+	int* cer_left;          /* cer_left[c*(n+1)+d] is the number of positions order[d..n-1] tested by ceremony c */
+	int* matches;           /* The current number of matches of each ceremony */
+	int unused;             /* Bit elt is set if elt is not used yet */
+	int once;               /* Bit elt is set if elt is used once */
+	int twice;              /* Bit elt is set if elt is used twice */
+	int doublon_elts;       /* Bit elt is set if elt is at a doublon position (so it must be used twice) */
+	long long* proba_right; /* Number of possible arrangements with elt at pos, in proba_right[elt*n+pos] */
+	int* first;             /* If not NULL, the first possible arrangement found is set here, and the search stops */
+	int current[MAX_N];     /* The element at each position filled (used with first) */
+	uint64_t* seed;         /* If not NULL, the elements are tried in a random order (used with first) */
+};
+
+/* Returns the number of the lowest bit set in mask (mask != 0) */
+int lowest_bit(int mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	int b;
+	for(b=0 ; !((mask >> b) & 1) ; b++)
+		;
+	return b;
+#endif
+}
+
+/* Returns the elements that can be set at order[depth], knowing the positions before */
+int backtrack_cand(const struct backtrack* bt, int depth)
+{
+	int c;
+	const int n = bt->n;
+	const int seconds = bt->doubles - popcount(bt->twice);         /* The second positions still to fill */
+	const int waiting = popcount(bt->doublon_elts & bt->once);     /* The elements at a doublon position, used once */
+	int cand = bt->allowed[depth] & bt->unused;
+	if(seconds > waiting) /* An element used once can be doubled */
+		cand |= bt->allowed[depth] & bt->once;
+	else /* Only the ones at a doublon position */
+		cand |= bt->allowed[depth] & bt->once & bt->doublon_elts;
+	if(bt->is_doublon[depth] && seconds <= waiting) /* A new element here would wait too */
+		cand &= ~bt->unused;
+	for(c=0 ; c<bt->n_cer && cand ; c++) {
+		const int e = bt->cer_elt[c*n+depth];
+		if(bt->matches[c] == bt->cer_matches[c]) { /* No more match */
+			if(e >= 0)
+				cand &= ~(1 << e);
+		} else if(bt->matches[c] + bt->cer_left[c*(n+1)+depth+1] < bt->cer_matches[c]) /* Must match here */
+			cand &= (e >= 0) ? (1 << e) : 0;
+	}
+	return cand;
+}
+
+/* Returns YES if all ceremonies have their number of matches (once all positions are filled) */
+int backtrack_matched(const struct backtrack* bt)
+{
+	for(int c=0 ; c<bt->n_cer ; c++)
+		if(bt->matches[c] != bt->cer_matches[c])
+			return NO;
+	return YES;
+}
+
+/* Sets elt at order[depth] */
+void backtrack_set(struct backtrack* bt, int depth, int elt)
+{
+	const int bit = 1 << elt;
+	if(bt->is_doublon[depth])
+		bt->doublon_elts |= bit;
+	if(bt->unused & bit) {
+		bt->unused &= ~bit;
+		bt->once |= bit;
+	} else {
+		bt->once &= ~bit;
+		bt->twice |= bit;
+	}
+	for(int c=0 ; c<bt->n_cer ; c++)
+		bt->matches[c] += (bt->cer_elt[c*bt->n+depth] == elt);
+	bt->current[bt->order[depth]] = elt;
+}
+
+/* Unsets elt at order[depth], doublon_elts being its value before backtrack_set() */
+void backtrack_unset(struct backtrack* bt, int depth, int elt, int doublon_elts)
+{
+	const int bit = 1 << elt;
+	for(int c=0 ; c<bt->n_cer ; c++)
+		bt->matches[c] -= (bt->cer_elt[c*bt->n+depth] == elt);
+	if(bt->twice & bit) {
+		bt->twice &= ~bit;
+		bt->once |= bit;
+	} else {
+		bt->once &= ~bit;
+		bt->unused |= bit;
+	}
+	bt->doublon_elts = doublon_elts;
+}
+
+/* Fills the position order[depth] and the next ones, in all possible ways,
+	adds to proba_right[] the arrangements found, and returns their number
+*/
+long long backtrack_fill(struct backtrack* bt, int depth)
+{
+	int elt;
+	long long nb_right = 0;
+	const int n = bt->n;
+	if(depth == n) { /* One more possible arrangement, if the ceremonies have their matches */
+		if(!backtrack_matched(bt))
+			return 0;
+		if(bt->first != NULL)
+			memcpy(bt->first, bt->current, n * sizeof(int));
+		return 1;
+	}
+
+	for(int cand = backtrack_cand(bt, depth) ; cand ; cand &= ~(1 << elt)) {
+		elt = lowest_bit(cand);
+		if(bt->seed != NULL) /* A random one */
+			for(int k = (int)(next_random(bt->seed) % popcount(cand)) ; k > 0 ; k--)
+				elt = lowest_bit(cand & ~((2 << elt) - 1));
+		const int doublon_elts = bt->doublon_elts;
+		backtrack_set(bt, depth, elt);
+		const long long nb = backtrack_fill(bt, depth+1);
+		bt->proba_right[elt*n+bt->order[depth]] += nb;
+		nb_right += nb;
+		if(nb > 0 && bt->first != NULL)
+			return nb;
+		backtrack_unset(bt, depth, elt, doublon_elts);
+	}
+	return nb_right;
+}
+
+/* Inits bt for n positions, m elements and the n_ev events evs[], with no position filled yet */
+void init_backtrack(struct backtrack* bt, int n, int m, const struct event* evs, int n_ev)
+{
+	int i, j, c, d;
+	struct predicate pred;
+	int allowed[MAX_N], is_doublon[MAX_N] = { 0 };
+	compile_events(n, &pred, evs, n_ev);
+	for(j=0 ; j<n ; j++)
+		allowed[j] = (1 << m) - 1;
+	for(i=0 ; i<pred.n_booth ; i++)
+		allowed[pred.booth_pos[i]] &= pred.booth_allowed[i];
+	for(i=0 ; i<pred.n_doublon ; i++)
+		is_doublon[pred.doublon_pos[i]] = YES;
+
+	/* The most constrained positions first : fewer allowed elements */
+	bt->n = n;
+	bt->m = m;
+	bt->doubles = n-m;
+	for(j=0 ; j<n ; j++)
+		bt->order[j] = j;
+	for(i=1 ; i<n ; i++)
+		for(j=i ; j>0 && popcount(allowed[bt->order[j]]) < popcount(allowed[bt->order[j-1]]) ; j--) {
+			int t = bt->order[j]; bt->order[j] = bt->order[j-1]; bt->order[j-1] = t;
+		}
+	for(d=0 ; d<n ; d++) {
+		bt->allowed[d] = allowed[bt->order[d]];
+		bt->is_doublon[d] = is_doublon[bt->order[d]];
+	}
+
+	/* The ceremonies, in the order of the positions */
+	bt->n_cer = pred.n_ceremony;
+	bt->cer_elt = new_array(bt->n_cer * n);
+	bt->cer_matches = new_array(bt->n_cer);
+	bt->cer_left = new_array(bt->n_cer * (n+1));
+	bt->matches = new_array(bt->n_cer);
+	for(c=0 ; c<bt->n_cer ; c++) {
+		bt->cer_matches[c] = 16 - pred.cer_differ[c];
+		bt->matches[c] = 0;
+		bt->cer_left[c*(n+1)+n] = 0;
+		for(d=n-1 ; d>=0 ; d--) {
+			const int elt = (int)((pred.cer_code[c] >> (4*bt->order[d])) & 0xF);
+			bt->cer_elt[c*n+d] = (elt == 0xF) ? -1 : elt;
+			bt->cer_left[c*(n+1)+d] = bt->cer_left[c*(n+1)+d+1] + (elt != 0xF);
+		}
+	}
+	free_predicate(&pred);
+
+	bt->unused = (1 << m) - 1;
+	bt->once = 0;
+	bt->twice = 0;
+	bt->doublon_elts = 0;
+	bt->proba_right = NULL;
+	bt->first = NULL;
+	bt->seed = NULL;
+}
+
+/* Frees the arrays of bt */
+void free_backtrack(struct backtrack* bt)
+{
+	free(bt->cer_elt);
+	free(bt->cer_matches);
+	free(bt->cer_left);
+	free(bt->matches);
+}
+
+/* Counts the arrangements of m elements in n positions still possible knowing the n_ev events evs[]
+	Sets *nb_right, and proba_right[elt*n+pos] (size n*m) to the number of them with elt at pos
+	If first is not NULL, only looks for one possible arrangement : sets first[] to it, and *nb_right to 1 (or 0 if none),
+	trying the elements in a random order if seed is not NULL
+*/
+void count_backtrack_first(int n, int m, const struct event* evs, int n_ev, long long* nb_right, long long* proba_right, int* first, uint64_t* seed)
+{
+	struct backtrack bt;
+	init_backtrack(&bt, n, m, evs, n_ev);
+	bt.proba_right = proba_right;
+	bt.first = first;
+	bt.seed = seed;
+	for(int i=0 ; i<n*m ; i++)
+		proba_right[i] = 0;
+	*nb_right = backtrack_fill(&bt, 0);
+	free_backtrack(&bt);
+}
+
+/*
+	Counting by dynamic programming : the backtracking reviews the same endings again
+	for all the beginnings that lead to the same state. Here the positions are filled level by level
+	(in the order of the backtracking), and the beginnings that lead to the same state are merged.
+	A state is : the elements unused, used once, used twice, the ones at doublon positions,
+	and the number of matches of each ceremony so far (the pruning of backtrack_cand() still applies).
+	Then the endings are counted backward, level by level, and each element at a position counts
+	the beginnings times the endings it joins.
+*/
+struct dp_level {
+	int kw;          /* Number of words of a key */
+	int size;        /* Number of slots (a power of 2) */
+	int count;       /* Number of states */
+	uint64_t* keys;  /* The key of each slot (kw words), DP_EMPTY in the first word for an empty slot */
+	long long* fwd;  /* Number of beginnings that lead to each state */
+	long long* comp; /* Number of endings of each state */
+};
+
+#define DP_EMPTY (~(uint64_t)0) /* The first word of the key of an empty slot */
+
+/* Creates an empty level for keys of kw words */
+struct dp_level* new_dp_level(int kw, int size)
+{
+	struct dp_level* lv = (struct dp_level*)malloc(sizeof(struct dp_level));
+	if(!lv) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	lv->kw = kw;
+	lv->size = size;
+	lv->count = 0;
+	lv->keys = new_codes(size * kw);
+	lv->fwd = new_counts(size);
+	lv->comp = new_counts(size);
+	for(int i=0 ; i<size ; i++)
+		lv->keys[i*kw] = DP_EMPTY;
+	return lv;
+}
+
+/* Frees the level lv */
+void free_dp_level(struct dp_level* lv)
+{
+	free(lv->keys);
+	free(lv->fwd);
+	free(lv->comp);
+	free(lv);
+}
+
+/* Returns the slot of key in lv, or -1 if not found and not insert; with insert, adds key if not found */
+int dp_find(struct dp_level* lv, const uint64_t* key, int insert)
+{
+	int i, k;
+	uint64_t h = 0;
+	for(k=0 ; k<lv->kw ; k++)
+		h = (h ^ key[k]) * 0x9E3779B97F4A7C15ULL;
+	for(i = (int)(h >> 32) & (lv->size-1) ; lv->keys[i*lv->kw] != DP_EMPTY ; i = (i+1) & (lv->size-1))
+		if(memcmp(lv->keys + i*lv->kw, key, lv->kw * sizeof(uint64_t)) == 0)
+			return i;
+	if(!insert)
+		return -1;
+	if(2 * (lv->count+1) > lv->size) { /* Too full : twice bigger */
+		struct dp_level* big = new_dp_level(lv->kw, 2 * lv->size);
+		for(k=0 ; k<lv->size ; k++)
+			if(lv->keys[k*lv->kw] != DP_EMPTY) {
+				const int j = dp_find(big, lv->keys + k*lv->kw, YES);
+				big->fwd[j] = lv->fwd[k];
+				big->comp[j] = lv->comp[k];
+			}
+		free(lv->keys);
+		free(lv->fwd);
+		free(lv->comp);
+		*lv = *big;
+		free(big);
+		return dp_find(lv, key, YES);
+	}
+	memcpy(lv->keys + i*lv->kw, key, lv->kw * sizeof(uint64_t));
+	lv->count++;
+	return i;
+}
+
+/* The matches of the ceremonies in the words of a key after the first : up to 16 matches (n = 16), so 5 bits each */
+#define DP_MATCH_BITS  5
+#define DP_MATCH_WORD  12 /* Matches in a word */
+#define DP_MATCH_MASK  0x1F
+
+/* Sets key[] (kw words) to the state of bt */
+void dp_key(const struct backtrack* bt, uint64_t* key, int kw)
+{
+	int c;
+	key[0] = (uint64_t)bt->unused | (uint64_t)bt->once << 16 | (uint64_t)bt->twice << 32 | (uint64_t)bt->doublon_elts << 48;
+	for(c=1 ; c<kw ; c++)
+		key[c] = 0;
+	for(c=0 ; c<bt->n_cer ; c++)
+		key[1 + c/DP_MATCH_WORD] |= (uint64_t)bt->matches[c] << (DP_MATCH_BITS * (c%DP_MATCH_WORD));
+}
+
+/* Sets the state of bt to key[] */
+void dp_load(struct backtrack* bt, const uint64_t* key)
+{
+	bt->unused = (int)(key[0] & 0xFFFF);
+	bt->once = (int)((key[0] >> 16) & 0xFFFF);
+	bt->twice = (int)((key[0] >> 32) & 0xFFFF);
+	bt->doublon_elts = (int)((key[0] >> 48) & 0xFFFF);
+	for(int c=0 ; c<bt->n_cer ; c++)
+		bt->matches[c] = (int)((key[1 + c/DP_MATCH_WORD] >> (DP_MATCH_BITS * (c%DP_MATCH_WORD))) & DP_MATCH_MASK);
+}
+
+/* The levels of the dynamic programming, with the endings of each state,
+	kept to draw possible arrangements at random (see dp_sample())
+*/
+struct dp_table {
+	struct backtrack bt;             /* The events, and the order of the positions */
+	int kw;                          /* Number of words of a key */
+	uint64_t* key;                   /* A key (kw words) */
+	struct dp_level* level[MAX_N+1]; /* The states with 0 to n positions filled */
+	long long nb_right;              /* Number of possible arrangements : the endings of the state with no position filled */
+	long long n_states;              /* Number of states */
+};
+
+/* Frees what init_dp() has allocated (the levels built so far) */
+void free_dp(struct dp_table* dp)
+{
+	for(int d=0 ; d<=dp->bt.n ; d++)
+		if(dp->level[d] != NULL)
+			free_dp_level(dp->level[d]);
+	free(dp->key);
+	free_backtrack(&dp->bt);
+}
+
+/* Builds the levels of dp for m elements in n positions knowing the n_ev events evs[],
+	and sets proba_right[elt*n+pos] (size n*m, if not NULL) to the number of possible arrangements with elt at pos
+	If deadline is not 0, gives up when now_seconds() passes it : frees dp and returns NO (YES if built)
+*/
+#define DP_CHECK 4095 /* The deadline is checked every DP_CHECK+1 slots */
+int init_dp(struct dp_table* dp, int n, int m, const struct event* evs, int n_ev, long long* proba_right, double deadline)
+{
+	int d, i, elt;
+	struct backtrack* bt = &dp->bt;
+	struct dp_level** level = dp->level;
+	init_backtrack(bt, n, m, evs, n_ev);
+	for(d=0 ; d<=n ; d++)
+		level[d] = NULL;
+	const int kw = dp->kw = 1 + (bt->n_cer + DP_MATCH_WORD-1) / DP_MATCH_WORD;
+	uint64_t* key = dp->key = new_codes(kw);
+	for(i=0 ; proba_right != NULL && i<n*m ; i++)
+		proba_right[i] = 0;
+	dp->n_states = 0;
+
+	/* Forward : the beginnings */
+	level[0] = new_dp_level(kw, 16);
+	dp_key(bt, key, kw);
+	i = dp_find(level[0], key, YES);
+	level[0]->fwd[i] = 1;
+	for(d=0 ; d<n ; d++) {
+		struct dp_level* lv = level[d];
+		level[d+1] = new_dp_level(kw, 16);
+		for(i=0 ; i<lv->size ; i++) {
+			if(deadline > 0 && (i & DP_CHECK) == 0 && now_seconds() > deadline) {
+				free_dp(dp);
+				return NO;
+			}
+			if(lv->keys[i*kw] == DP_EMPTY)
+				continue;
+			dp_load(bt, lv->keys + i*kw);
+			for(int cand = backtrack_cand(bt, d) ; cand ; cand &= cand-1) {
+				elt = lowest_bit(cand);
+				const int doublon_elts = bt->doublon_elts;
+				backtrack_set(bt, d, elt);
+				dp_key(bt, key, kw);
+				const int j = dp_find(level[d+1], key, YES); /* Before reading level[d+1]->fwd, that can grow */
+				level[d+1]->fwd[j] += lv->fwd[i];
+				backtrack_unset(bt, d, elt, doublon_elts);
+			}
+		}
+		dp->n_states += lv->count;
+	}
+
+	/* Backward : the endings, and the counts of each element at each position */
+	for(i=0 ; i<level[n]->size ; i++) /* The full arrangements, if the ceremonies have their matches */
+		if(level[n]->keys[i*kw] != DP_EMPTY) {
+			dp_load(bt, level[n]->keys + i*kw);
+			level[n]->comp[i] = backtrack_matched(bt);
+		}
+	for(d=n-1 ; d>=0 ; d--) {
+		struct dp_level* lv = level[d];
+		for(i=0 ; i<lv->size ; i++) {
+			if(deadline > 0 && (i & DP_CHECK) == 0 && now_seconds() > deadline) {
+				free_dp(dp);
+				return NO;
+			}
+			if(lv->keys[i*kw] == DP_EMPTY)
+				continue;
+			dp_load(bt, lv->keys + i*kw);
+			for(int cand = backtrack_cand(bt, d) ; cand ; cand &= cand-1) {
+				elt = lowest_bit(cand);
+				const int doublon_elts = bt->doublon_elts;
+				backtrack_set(bt, d, elt);
+				dp_key(bt, key, kw);
+				const long long comp = level[d+1]->comp[dp_find(level[d+1], key, NO)];
+				lv->comp[i] += comp;
+				if(proba_right != NULL)
+					proba_right[elt*n+bt->order[d]] += lv->fwd[i] * comp;
+				backtrack_unset(bt, d, elt, doublon_elts);
+			}
+		}
+	}
+	dp->nb_right = 0;
+	for(i=0 ; i<level[0]->size ; i++) /* The only state with no position filled */
+		if(level[0]->keys[i*kw] != DP_EMPTY)
+			dp->nb_right = level[0]->comp[i];
+	return YES;
+}
+
+/* Returns a random number from 0 to max-1 (max > 0), all with the same probability */
+uint64_t random_below(uint64_t max, uint64_t* seed)
+{
+	const uint64_t limit = UINT64_MAX - UINT64_MAX % max; /* A multiple of max */
+	uint64_t r;
+	do
+		r = next_random(seed);
+	while(r >= limit);
+	return r % max;
+}
+
+/* Draws a possible arrangement in ta[], each one with the same probability, and returns NO if there is none :
+	position by position, each element is taken with the probability of its endings among the endings of the state
+*/
+int dp_sample(struct dp_table* dp, int* ta, uint64_t* seed)
+{
+	int d, i;
+	struct backtrack* bt = &dp->bt;
+	const int kw = dp->kw;
+	if(dp->nb_right == 0)
+		return NO;
+	for(i=0 ; dp->level[0]->keys[i*kw] == DP_EMPTY ; i++) /* The state with no position filled */
+		;
+	dp_load(bt, dp->level[0]->keys + i*kw);
+	uint64_t r = random_below((uint64_t)dp->nb_right, seed); /* The arrangement drawn, among the endings of the state */
+	for(d=0 ; d<bt->n ; d++)
+		for(int cand = backtrack_cand(bt, d) ; cand ; cand &= cand-1) {
+			const int elt = lowest_bit(cand);
+			const int doublon_elts = bt->doublon_elts;
+			backtrack_set(bt, d, elt);
+			dp_key(bt, dp->key, kw);
+			const uint64_t comp = (uint64_t)dp->level[d+1]->comp[dp_find(dp->level[d+1], dp->key, NO)];
+			if(r < comp) { /* In the endings of elt */
+				ta[bt->order[d]] = elt;
+				break;
+			}
+			r -= comp;
+			backtrack_unset(bt, d, elt, doublon_elts);
+		}
+	return YES;
+}
+
+/* Counts the arrangements of m elements in n positions still possible knowing the n_ev events evs[], by dynamic programming
+	Sets *nb_right, and proba_right[elt*n+pos] (size n*m) to the number of them with elt at pos
+	(the same result as count_backtrack()), and returns the number of states reviewed
+*/
+long long count_dp(int n, int m, const struct event* evs, int n_ev, long long* nb_right, long long* proba_right)
+{
+	struct dp_table dp;
+	init_dp(&dp, n, m, evs, n_ev, proba_right, 0);
+	*nb_right = dp.nb_right;
+	free_dp(&dp);
+	return dp.n_states;
+}
+
+/* Counts the arrangements of m elements in n positions still possible knowing the n_ev events evs[] (see count_backtrack_first()) */
+void count_backtrack(int n, int m, const struct event* evs, int n_ev, long long* nb_right, long long* proba_right)
+{
+	count_backtrack_first(n, m, evs, n_ev, nb_right, proba_right, NULL, NULL);
+}
+
+#define COUNT_BACKTRACK 1 /* Count by backtracking (see count_backtrack()) */
+#define COUNT_DP        2 /* Count by dynamic programming (see count_dp()) */
+
+/* Counts the arrangements of m elements in n positions still possible knowing the n_ev events evs[],
+	with the method COUNT_BACKTRACK or COUNT_DP (the same result), and returns the number of states reviewed by COUNT_DP (0 otherwise)
+*/
+long long count_exact(int method, int n, int m, const struct event* evs, int n_ev, long long* nb_right, long long* proba_right)
+{
+	if(method == COUNT_DP)
+		return count_dp(n, m, evs, n_ev, nb_right, proba_right);
+	count_backtrack(n, m, evs, n_ev, nb_right, proba_right);
+	return 0;
+}
+
+/* Prints probability of having each of the m elements to each of the n positions knowing the n_ev events evs[],
+	counted with the method COUNT_BACKTRACK or COUNT_DP (the same result as print_proba_right())
+*/
+void print_proba_backtrack(int method, int n, int m, const struct event* evs, int n_ev, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	long long nb_right;
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	long long* proba_right = new_counts(n*m);
+	const long long n_states = count_exact(method, n, m, evs, n_ev, &nb_right, proba_right);
+	print_proba(n, m, nb_right, n_arrangements_of(n, m), proba_right, nelt, npos);
+	free(proba_right);
+	if(method == COUNT_DP)
+		stats_record("print", "dp", wall0, cpu0, ",\"events\":%d,\"possible\":%lld,\"states\":%lld", n_ev, nb_right, n_states);
+	else
+		stats_record("print", "backtrack", wall0, cpu0, ",\"events\":%d,\"possible\":%lld", n_ev, nb_right);
+}
+
+/*
+	Monte Carlo estimation, for the seasons too big to count (n up to MAX_N, m elements with m <= n <= 2*m).
+	The arrangements are drawn at random among all of them, and the impossible ones are rejected.
+	When the events reject too many of them (less than 1 / SAMPLE_MIN_RATE accepted), a Markov chain
+	is used instead : a step swaps the elements of 2 positions, or turns the elements of 3 positions,
+	or gives an element used once to a position of an element used twice (so the doubled elements change),
+	and is kept only if the arrangement stays possible.
+	The moves are symmetric, so the uniform draw is kept by the chain, but the events can cut the possible
+	arrangements into groups the moves can not join : so each batch starts the chain from a possible
+	arrangement drawn exactly at random, by the dynamic programming (see dp_sample()).
+	The dynamic programming has half of the time budget : when it is too big for it, each batch starts
+	from a possible arrangement found by a random backtracking, and runs the chain for a while to forget the start,
+	which is not an exact random draw (the standard errors may then be too small).
+	The samples are counted by batches of SAMPLE_BATCH : with the random draw, or with the chain started anew,
+	the batches are independent, and the standard error of each probability comes from their spread
+	(unknown, and set to -1, with less than 2 batches).
+	The sampling stops when all standard errors are below the precision, or at the end of the time budget,
+	but not before SAMPLE_MIN batches.
+*/
+#define SAMPLE_BATCH    4096    /* Number of samples in a batch */
+#define SAMPLE_MIN      16      /* Min number of batches before stopping */
+#define SAMPLE_MIN_RATE 1000    /* The Markov chain is used if less than 1 in SAMPLE_MIN_RATE random arrangements are possible */
+#define SAMPLE_TRIES    1000000 /* Number of random arrangements tried before choosing between rejection and Markov chain */
+
+#define SAMPLE_RANDOM    0 /* Random draw, and rejection */
+#define SAMPLE_CHAIN     1 /* Markov chain, started by the dynamic programming */
+#define SAMPLE_CHAIN_BT  2 /* Markov chain, started by a random backtracking */
+
+double sample_precision = 0.5; /* Target standard error of the probabilities, in % (option --precision) */
+
+/* Draws a random arrangement of m elements in n positions in ta[], and returns it packed :
+	the n-m elements used twice are drawn first (each choice gives as many arrangements), then the order
+*/
+uint64_t random_arrangement(int n, int m, int* ta, uint64_t* seed)
+{
+	int i, j, t;
+	for(i=0 ; i<m ; i++)
+		ta[i] = i;
+	for(i=0 ; i<n-m ; i++) { /* The doubled elements : the first n-m ones of a partial shuffle */
+		j = i + (int)(next_random(seed) % (m-i));
+		t = ta[i]; ta[i] = ta[j]; ta[j] = t;
+		ta[m+i] = ta[i];
+	}
+	for(i=n-1 ; i>0 ; i--) {
+		j = (int)(next_random(seed) % (i+1));
+		t = ta[i]; ta[i] = ta[j]; ta[j] = t;
+	}
+	return pack_arrangement(ta, n);
+}
+
+/* One step of the Markov chain from the possible arrangement ta[] (packed in *code) of m elements in n positions,
+	used[elt] being the number of positions of elt
+*/
+void chain_step(int n, int m, int* ta, uint64_t* code, int* used, const struct predicate* pred, uint64_t* seed)
+{
+	const int p = (int)(next_random(seed) % n);
+	const uint64_t r = next_random(seed);
+	const int q = (p + 1 + (int)((r >> 2) % (n-1))) % n;
+	uint64_t next;
+	if(r % 4 < 2) { /* Swap the elements of p and q */
+		const uint64_t x = (uint64_t)(ta[p] ^ ta[q]);
+		next = *code ^ (x << (4*p)) ^ (x << (4*q));
+		if(x == 0 || !is_possible_all(next, pred))
+			return;
+		ta[p] ^= (int)x;
+		ta[q] ^= (int)x;
+	} else if(r % 4 == 2) { /* Turn the elements of p, q and t : p gets the one of t, q of p, and t of q */
+		int t, k;
+		if(n < 3)
+			return;
+		t = (int)(next_random(seed) % (n-2)); /* Drawn apart from q, so (p, t, q) that turns back is as likely */
+		t += (t >= (p < q ? p : q)); /* t is not p or q */
+		t += (t >= (p < q ? q : p));
+		next = (*code & ~((uint64_t)0xF << (4*p)) & ~((uint64_t)0xF << (4*q)) & ~((uint64_t)0xF << (4*t)))
+			| ((uint64_t)ta[t] << (4*p)) | ((uint64_t)ta[p] << (4*q)) | ((uint64_t)ta[q] << (4*t));
+		if(!is_possible_all(next, pred))
+			return;
+		k = ta[t];
+		ta[t] = ta[q];
+		ta[q] = ta[p];
+		ta[p] = k;
+	} else { /* Give another element e to p, if p has an element used twice and e is used once : e is then doubled */
+		int e;
+		if(m < 2)
+			return;
+		e = (int)((r >> 2) % (m-1));
+		e += (e >= ta[p]);
+		if(used[ta[p]] != 2 || used[e] != 1)
+			return;
+		next = (*code & ~((uint64_t)0xF << (4*p))) | ((uint64_t)e << (4*p));
+		if(!is_possible_all(next, pred))
+			return;
+		used[ta[p]]--;
+		used[e]++;
+		ta[p] = e;
+	}
+	*code = next;
+}
+
+/* Sets ta[] (packed in *code) to a possible arrangement drawn exactly at random by dp (see dp_sample()),
+	or without dp (NULL), found by a random backtracking then moved by the chain for a while;
+	sets used[elt] (size m) to the number of positions of elt, and returns NO if there is no possible arrangement
+*/
+int chain_start(struct dp_table* dp, int n, int m, const struct event* evs, int n_ev, const struct predicate* pred,
+	int* ta, uint64_t* code, int* used, uint64_t* seed)
+{
+	int i;
+	if(dp != NULL && !dp_sample(dp, ta, seed))
+		return NO;
+	if(dp == NULL) {
+		long long found;
+		long long* unused = new_counts(n*m);
+		count_backtrack_first(n, m, evs, n_ev, &found, unused, ta, seed);
+		free(unused);
+		if(found == 0)
+			return NO;
+	}
+	*code = pack_arrangement(ta, n);
+	for(i=0 ; i<m ; i++)
+		used[i] = 0;
+	for(i=0 ; i<n ; i++)
+		used[ta[i]]++;
+	for(i=0 ; dp == NULL && i<n*SAMPLE_BATCH ; i++)
+		chain_step(n, m, ta, code, used, pred, seed);
+	return YES;
+}
+
+/* Estimates the probability of each of the m elements at each of the n positions knowing the n_ev events evs[] :
+	proba[elt*n+pos] and its standard error err[elt*n+pos] (size n*m, in %),
+	with time_budget seconds at most (after SAMPLE_MIN batches); sets *chain to the way of sampling (SAMPLE_RANDOM, SAMPLE_CHAIN
+	or SAMPLE_CHAIN_BT), *rate to the part of the random arrangements possible (with SAMPLE_RANDOM),
+	and returns the number of samples (0 if no possible arrangement)
+*/
+long long sample_proba(int n, int m, const struct event* evs, int n_ev, double* proba, double* err, int* chain, double* rate)
+{
+	int i, pos, ta[MAX_N], used[MAX_N];
+	long long n_tries = 0, n_ok = 0, n_batches = 0;
+	const int nsq = n * m;
+	uint64_t seed = 0x2545F4914F6CDD1DULL, code = 0;
+	struct predicate pred;
+	struct dp_table dp;
+	int* counts = new_array(nsq);
+	double* sum = (double*)calloc(nsq, sizeof(double));
+	double* sum2 = (double*)calloc(nsq, sizeof(double));
+	if(!sum || !sum2) {
+		fprintf(stderr, "error : calloc()\n");
+		exit(1);
+	}
+	compile_events(n, &pred, evs, n_ev);
+	const double start = now_seconds();
+
+	/* Rejection or Markov chain */
+	while(n_tries < SAMPLE_TRIES && n_ok < SAMPLE_TRIES / SAMPLE_MIN_RATE) {
+		code = random_arrangement(n, m, ta, &seed);
+		n_tries++;
+		n_ok += is_possible_all(code, &pred);
+	}
+	*rate = (double)n_ok / n_tries;
+	*chain = SAMPLE_RANDOM;
+	if(n_ok < SAMPLE_TRIES / SAMPLE_MIN_RATE) /* The dynamic programming, if it is built in half of the time */
+		*chain = init_dp(&dp, n, m, evs, n_ev, NULL, start + time_budget / 2) ? SAMPLE_CHAIN : SAMPLE_CHAIN_BT;
+	if(*chain && !chain_start(*chain == SAMPLE_CHAIN ? &dp : NULL, n, m, evs, n_ev, &pred, ta, &code, used, &seed)) {
+		if(*chain == SAMPLE_CHAIN) /* No possible arrangement */
+			free_dp(&dp);
+		free_predicate(&pred);
+		free(counts);
+		free(sum);
+		free(sum2);
+		return 0;
+	}
+
+	/* The batches */
+	do {
+		for(i=0 ; i<nsq ; i++)
+			counts[i] = 0;
+		if(*chain && n_batches > 0) /* A new chain */
+			chain_start(*chain == SAMPLE_CHAIN ? &dp : NULL, n, m, evs, n_ev, &pred, ta, &code, used, &seed);
+		for(i=0 ; i<SAMPLE_BATCH ; i++) {
+			if(*chain && i > 0)
+				for(pos=0 ; pos<n ; pos++) /* n steps between 2 samples */
+					chain_step(n, m, ta, &code, used, &pred, &seed);
+			else if(!*chain) {
+				do {
+					code = random_arrangement(n, m, ta, &seed);
+					n_tries++;
+				} while(!is_possible_all(code, &pred));
+				n_ok++;
+			}
+			for(pos=0 ; pos<n ; pos++)
+				counts[ta[pos]*n+pos]++;
+		}
+		for(i=0 ; i<nsq ; i++) {
+			const double mean = (double)counts[i] / SAMPLE_BATCH;
+			sum[i] += mean;
+			sum2[i] += mean * mean;
+		}
+		n_batches++;
+
+		/* The estimations */
+		double max_err = 0;
+		for(i=0 ; i<nsq ; i++) {
+			const double avg = sum[i] / n_batches;
+			const double var = n_batches > 1 ? (sum2[i] / n_batches - avg * avg) / (n_batches - 1) : 0;
+			proba[i] = 100 * avg;
+			err[i] = n_batches > 1 ? 100 * sqrt(var > 0 ? var : 0) : -1;
+			if(err[i] > max_err)
+				max_err = err[i];
+		}
+		if(n_batches >= SAMPLE_MIN && max_err <= sample_precision)
+			break;
+	} while(n_batches < SAMPLE_MIN || now_seconds() - start < time_budget);
+	if(!*chain)
+		*rate = (double)n_ok / n_tries;
+
+	if(*chain == SAMPLE_CHAIN)
+		free_dp(&dp);
+	free_predicate(&pred);
+	free(counts);
+	free(sum);
+	free(sum2);
+	return n_batches * SAMPLE_BATCH;
+}
+
+/* Prints the probability of having each of the m elements to each of the n positions knowing the n_ev events evs[],
+	estimated by Monte Carlo (see sample_proba()), with its standard error
+*/
+void print_proba_sample(int n, int m, const struct event* evs, int n_ev, const char nelt[][MAX_NAME+1], const char npos[][MAX_NAME+1])
+{
+	int pos, elt, chain;
+	double rate, max_err = 0;
+	double* proba = (double*)malloc(n * m * sizeof(double));
+	double* err = (double*)malloc(n * m * sizeof(double));
+	if(!proba || !err) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	const long long n_samples = sample_proba(n, m, evs, n_ev, proba, err, &chain, &rate);
+	for(pos=0 ; n_samples>0 && pos<n*m ; pos++)
+		if(err[pos] > max_err)
+			max_err = err[pos];
+	if(n_samples > 0 && err[0] < 0) /* Unknown with less than 2 batches */
+		max_err = -1;
+	stats_record("print", chain == SAMPLE_CHAIN_BT ? "sample_chain_bt" : chain ? "sample_chain" : "sample", wall0, cpu0, ",\"events\":%d,\"samples\":%lld,\"max_err\":%.4f",
+		n_ev, n_samples, max_err);
+	if(n_samples == 0) {
+		fprintf(stdout, "No possible arrangement\n\n");
+		free(proba);
+		free(err);
+		return;
+	}
+	if(chain == SAMPLE_CHAIN)
+		fprintf(stdout, "Estimation with %lld samples (Markov chain), ", n_samples);
+	else if(chain == SAMPLE_CHAIN_BT)
+		fprintf(stdout, "Estimation with %lld samples (Markov chain, started by backtracking : not exactly at random), ", n_samples);
+	else
+		fprintf(stdout, "Estimation with %lld samples (random), about %.4g possible arrangements, ", n_samples, rate * n_arrangements_of(n, m));
+	if(max_err < 0)
+		fprintf(stdout, "max standard error unknown\n");
+	else
+		fprintf(stdout, "max standard error %.2f%%\n", max_err);
+	fprintf(stdout, ".\t."); /* First header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\tpos=%d", pos);
+	fprintf(stdout, "\n");
+	fprintf(stdout, ".\t."); /* Second header */
+	for(pos=0 ; pos<n ; pos++)
+		fprintf(stdout, "\t%s", npos[pos]);
+	fprintf(stdout, "\n");
+	for(elt=0 ; elt<m ; elt++) { /* Content, with the standard error */
+		fprintf(stdout, "elt=%d", elt);
+		fprintf(stdout, "\t%s", nelt[elt]);
+		for(pos=0 ; pos<n ; pos++)
+			if(err[elt*n+pos] < 0)
+				fprintf(stdout, "\t%5.2f%%+-?", proba[elt*n+pos]);
+			else
+				fprintf(stdout, "\t%5.2f%%+-%.2f", proba[elt*n+pos], err[elt*n+pos]);
+		fprintf(stdout, "\n");
+	}
+	fprintf(stdout, "\n");
+	fflush(stdout);
+	free(proba);
+	free(err);
+}
+
+/* Test of every functions,
+	assuming that the answer is (0, 1, 2, 3, 4, 5, 5)
+*/
+void test_small()
+{
+	int elt, pos, couple, matches;
+
+	const int n = 7;         /* Number of elements and positions; we have n-1 elements in n positions */
+	const long long n_arr = n_arrangements(n); /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
+	const char npos[7][MAX_NAME+1] = { "Ah", "Do", "Ve", "So", "Gi", "Co", "Ta" };
+	const char nelt[6][MAX_NAME+1] = { "Ka", "Ke", "Ki", "Ko", "Ku", "Ky" };
+
+	/* Init right */
+	struct right* right = init_right(n); /* The set of possible arrangements */
+	long long nb_right = n_arr;
+	print_proba_right(n, right, nb_right, nelt, npos);
+
+	/* add_new_couple() */
+	elt = 3;
 	pos = 3;
 	couple = YES;
-	nb_right = add_new_couple(n, is_right, couple, elt, pos, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_new_couple(n, right, couple, elt, pos, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_new_couple() */
 	elt = 5;
 	pos = 1;
 	couple = NO;
-	nb_right = add_new_couple(n, is_right, couple, elt, pos, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_new_couple(n, right, couple, elt, pos, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_ceremony() */
 	const int a_elt_1[7] = { 1, 5, 2, 3, -1, 0, 4 };
 	matches = 2;
-	nb_right = add_ceremony(n, is_right, a_elt_1, matches, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_ceremony(n, right, a_elt_1, matches, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_ceremony() */
 	const int a_elt_2[7] = { 0, 5, -1, 3, 4, 1, 2 };
 	matches = 3;
-	nb_right = add_ceremony(n, is_right, a_elt_2, matches, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_ceremony(n, right, a_elt_2, matches, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_new_couple() */
 	elt = 5;
 	pos = 2;
 	couple = NO;
-	nb_right = add_new_couple(n, is_right, couple, elt, pos, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_new_couple(n, right, couple, elt, pos, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_the_doublon() */
 	pos = 6;
-	nb_right = add_the_doublon(n, is_right, pos, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_the_doublon(n, right, pos, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_new_couple() */
 	elt = 5;
 	pos = 6;
 	couple = YES;
-	nb_right = add_new_couple(n, is_right, couple, elt, pos, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_new_couple(n, right, couple, elt, pos, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
 
 	/* add_ceremony() */
 	const int a_elt_3[7] = { 0, 1, 2, 5, 4, 3, -1 };
 	matches = 4;
-	nb_right = add_ceremony(n, is_right, a_elt_3, matches, nelt, npos);
-	print_proba_right(n, is_right, nb_right, nelt, npos);
+	nb_right = add_ceremony(n, right, a_elt_3, matches, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
+
+	//print_is_right(n, right);
+	free_right(right);
+}
+
+/* The events of test_small() */
+const struct event small_events[] = {
+	/* Week 1 */
+	{ EV_COUPLE, YES, 3, 3, 0, { 0 } },
+	{ EV_COUPLE, NO , 5, 1, 0, { 0 } },
+	{ EV_CEREMONY, 0, 0, 0, 2, { 1, 5, 2, 3, -1, 0, 4 } },
+	/* Week 2 */
+	{ EV_CEREMONY, 0, 0, 0, 3, { 0, 5, -1, 3, 4, 1, 2 } },
+	{ EV_COUPLE, NO , 5, 2, 0, { 0 } },
+	{ EV_DOUBLON, 0, 0, 6, 0, { 0 } },
+	{ EV_COUPLE, YES, 5, 6, 0, { 0 } },
+	{ EV_CEREMONY, 0, 0, 0, 4, { 0, 1, 2, 5, 4, 3, -1 } }
+};
+#define N_SMALL_EVENTS 8
+
+/* Same events as test_small(), applied week by week :
+	the last result must be the same as test_small()
+*/
+void test_small_batch()
+{
+	const int n = 7;
+	const long long n_arr = n_arrangements(n);
+	const char npos[7][MAX_NAME+1] = { "Ah", "Do", "Ve", "So", "Gi", "Co", "Ta" };
+	const char nelt[6][MAX_NAME+1] = { "Ka", "Ke", "Ki", "Ko", "Ku", "Ky" };
+
+	struct right* right = init_right(n);
+	long long nb_right = n_arr;
+	print_proba_right(n, right, nb_right, nelt, npos);
+	nb_right = add_events(n, right, small_events, 3, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
+	nb_right = add_events(n, right, small_events+3, 5, nelt, npos);
+	print_proba_right(n, right, nb_right, nelt, npos);
+	free_right(right);
+}
+
+/* Same events as test_small(), counted by backtracking after each event :
+	the counts must be the same as the review of all arrangements
+*/
+void test_backtrack()
+{
+	const int n = 7;
+	const int nsq = n * (n-1);
+	long long nb_right;
+	long long proba_right[7*6];
+	struct right* right = init_right(n);
+	for(int k=1 ; k<=N_SMALL_EVENTS ; k++) {
+		int errors = 0;
+		apply_event(n, right, &small_events[k-1]);
+		count_backtrack(n, n-1, small_events, k, &nb_right, proba_right);
+		for(int i=0 ; i<nsq ; i++)
+			if(proba_right[i] != right->proba_right[i])
+				errors++;
+		fprintf(stdout, "events = %d, nb_right = %lld, backtrack = %lld, errors = %d\n", k, right->nb_right, nb_right, errors);
+	}
+	free_right(right);
+}
 
-	//print_is_right(n, is_right);
-	free(is_right);
+/* Same events as test_small(), counted by dynamic programming after each event :
+	the counts must be the same as the review of all arrangements
+*/
+void test_dp()
+{
+	const int n = 7;
+	const int nsq = n * (n-1);
+	long long nb_right;
+	long long proba_right[7*6];
+	struct right* right = init_right(n);
+	for(int k=1 ; k<=N_SMALL_EVENTS ; k++) {
+		int errors = 0;
+		apply_event(n, right, &small_events[k-1]);
+		count_dp(n, n-1, small_events, k, &nb_right, proba_right);
+		for(int i=0 ; i<nsq ; i++)
+			if(proba_right[i] != right->proba_right[i])
+				errors++;
+		fprintf(stdout, "events = %d, nb_right = %lld, dp = %lld, errors = %d\n", k, right->nb_right, nb_right, errors);
+	}
+	free_right(right);
+}
+
+/* Weeks 1 to 3 of the season 2 (seasons/season_2.txt) : 10 elements in 11 positions,
+	with too few possible arrangements for the random draw
+*/
+const struct event season_2_events[] = {
+	{ EV_DOUBLON, 0, 0, 10, 0, { 0 } },
+	/* Week 1 */
+	{ EV_COUPLE, NO , 6, 5, 0, { 0 } },
+	{ EV_CEREMONY, 0, 0, 0, 1, { 8, 9, 6, 2, 4, 1, 0, 5, 7, 3, -1 } },
+	/* Week 2 */
+	{ EV_COUPLE, YES, 4, 4, 0, { 0 } },
+	{ EV_COUPLE, NO , 4, 10, 0, { 0 } },
+	{ EV_CEREMONY, 0, 0, 0, 3, { 1, 9, -1, 7, 4, 3, 6, 0, 8, 2, 5 } },
+	/* Week 3 */
+	{ EV_COUPLE, NO , 7, 3, 0, { 0 } },
+	{ EV_CEREMONY, 0, 0, 0, 3, { 0, 6, 5, -1, 4, 3, 1, 9, 8, 7, 2 } }
+};
+#define N_SEASON_2_EVENTS 8
+#define SAMPLE_MAX_DEV    5 /* Max deviation from the exact probabilities, in standard errors */
+
+/* Compares the probabilities estimated by sample_proba() with the exact ones of n_ev events evs[],
+	and prints the max deviation, in standard errors
+*/
+void test_sample_events(int n, int m, const struct event* evs, int n_ev)
+{
+	int chain;
+	double rate, max_dev = 0;
+	long long nb_right;
+	long long* exact = new_counts(n * m);
+	double* proba = (double*)malloc(n * m * sizeof(double));
+	double* err = (double*)malloc(n * m * sizeof(double));
+	if(!proba || !err) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	count_dp(n, m, evs, n_ev, &nb_right, exact);
+	const long long n_samples = sample_proba(n, m, evs, n_ev, proba, err, &chain, &rate);
+	for(int i=0 ; i<n*m ; i++) {
+		const double dev = fabs(proba[i] - 100 * (double)exact[i] / nb_right);
+		if(dev > 0 && dev / (err[i] > 0 ? err[i] : 1e-9) > max_dev)
+			max_dev = dev / (err[i] > 0 ? err[i] : 1e-9);
+	}
+	fprintf(stdout, "n = %d, events = %d, nb_right = %lld, samples = %lld (%s), max deviation = %.2f standard errors\n",
+		n, n_ev, nb_right, n_samples, chain ? "chain" : "random", max_dev);
+	if(max_dev > SAMPLE_MAX_DEV)
+		fprintf(stdout, "error : deviation above %d standard errors\n", SAMPLE_MAX_DEV);
+	free(exact);
+	free(proba);
+	free(err);
+}
+
+/* Estimates the events of test_small() (random draw, then Markov chain as the events add up),
+	and the weeks 1 to 3 of the season 2 (Markov chain)
+*/
+void test_sample()
+{
+	for(int k=1 ; k<=N_SMALL_EVENTS ; k++)
+		test_sample_events(7, 6, small_events, k);
+	test_sample_events(11, 10, season_2_events, N_SEASON_2_EVENTS);
 }
 
 /* Some little macros to save place */
-#define TITLE(a) fprintf(stdout, "%s\n\n", a); fprintf(stderr, "%s\n\n", a); fflush(stderr);
-#define PPR      print_proba_right(n, is_right, nb_right, nelt, npos);
+#define TITLE(a) fprintf(stdout, "%s\n\n", a); fprintf(stderr, "%s\n\n", a); fflush(stderr); stats_title(a);
+#define PPR      print_proba_right(n, right, nb_right, nelt, npos);
 
 /* A real test, with the french's season 2 */
 void test_season_2()
 {
 	const int n = 11;            /* Number of elements and positions; we have n-1 elements in n positions */
-	const int n_arr = 199584000; /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
+	const long long n_arr = n_arrangements(n); /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
 	const char npos[][MAX_NAME+1] = {
 		"Daisie",      /* pos=0 */
 		"Hilona",      /* pos=1 */
@@ -515,71 +3371,71 @@ void test_season_2()
 		"Illan"        /* elt=9	*/
 	};
 
-	print_names(n, 0, nelt, npos);
+	print_names(n, n-1, 0, nelt, npos);
 
-	/* Init is_right[] */
+	/* Init right */
 	TITLE("Init")
-	int* is_right = init_is_right(n_arr); /* For each arrangement (size = n_arr), says if this arrangement is possible (=1) or not (=0) */
-	int nb_right = n_arr;
+	struct right* right = init_right(n); /* The set of possible arrangements */
+	long long nb_right = n_arr;
 	PPR
 
 	/* We already know who is the doublon */
 	TITLE("The doublon")
-	nb_right = add_the_doublon(n, is_right, /* pos = */ 10, npos);
+	nb_right = add_the_doublon(n, right, /* pos = */ 10, npos);
 	PPR
 
 	TITLE("Week  1")
-	nb_right = add_new_couple(n, is_right, NO , 6, 5, nelt, npos); PPR
-	const int e01[] = {8, 9, 6, 2, 4, 1, 0, 5, 7, 3, -1}; nb_right = add_ceremony(n, is_right, e01, 1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 6, 5, nelt, npos); PPR
+	const int e01[] = {8, 9, 6, 2, 4, 1, 0, 5, 7, 3, -1}; nb_right = add_ceremony(n, right, e01, 1, nelt, npos); PPR
 
 	TITLE("Week  2")
-	nb_right = add_new_couple(n, is_right, YES, 4, 4, nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, NO , 4, 10, nelt, npos); PPR
-	const int e02[] = {1, 9, -1, 7, 4, 3, 6, 0, 8, 2, 5}; nb_right = add_ceremony(n, is_right, e02, 3, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 4, 4, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 4, 10, nelt, npos); PPR
+	const int e02[] = {1, 9, -1, 7, 4, 3, 6, 0, 8, 2, 5}; nb_right = add_ceremony(n, right, e02, 3, nelt, npos); PPR
 
 	TITLE("Week  3")
-	nb_right = add_new_couple(n, is_right, NO , 7, 3, nelt, npos); PPR
-	const int e03[] = {0, 6, 5, -1, 4, 3, 1, 9, 8, 7, 2}; nb_right = add_ceremony(n, is_right, e03, 3, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 7, 3, nelt, npos); PPR
+	const int e03[] = {0, 6, 5, -1, 4, 3, 1, 9, 8, 7, 2}; nb_right = add_ceremony(n, right, e03, 3, nelt, npos); PPR
 
 	TITLE("Week  4")
-	nb_right = add_new_couple(n, is_right, YES, 8, 8, nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, NO , 8, 10, nelt, npos); PPR
-	const int e04[] = {2, 6, 3, 0, 4, 5, 1, 9, 8, 7, -1}; nb_right = add_ceremony(n, is_right, e04, 3, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 8, 8, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 8, 10, nelt, npos); PPR
+	const int e04[] = {2, 6, 3, 0, 4, 5, 1, 9, 8, 7, -1}; nb_right = add_ceremony(n, right, e04, 3, nelt, npos); PPR
 
 	TITLE("Week  5")
-	nb_right = add_new_couple(n, is_right, NO , 1, 6, nelt, npos); PPR
-	const int e05[] = {0, 3, 2, 1, 4, 9, 6, 5, 8, 7, -1}; nb_right = add_ceremony(n, is_right, e05, 5, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 1, 6, nelt, npos); PPR
+	const int e05[] = {0, 3, 2, 1, 4, 9, 6, 5, 8, 7, -1}; nb_right = add_ceremony(n, right, e05, 5, nelt, npos); PPR
 
 	TITLE("Week  6")
-	nb_right = add_new_couple(n, is_right, NO , 3, 1, nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, YES, 7, 7, nelt, npos); PPR
-	const int e06[] = {0, 2, 3, -1, 4, 5, 1, 9, 8, 7, 6}; nb_right = add_ceremony(n, is_right, e06, 4, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 3, 1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 7, 7, nelt, npos); PPR
+	const int e06[] = {0, 2, 3, -1, 4, 5, 1, 9, 8, 7, 6}; nb_right = add_ceremony(n, right, e06, 4, nelt, npos); PPR
 
 	TITLE("Week  7")
-	nb_right = add_new_couple(n, is_right, NO , 7, 10, nelt, npos); PPR
-	const int e07[] = {1, 2, 3, 0, 4, 5, 6, 7, 8, 9, -1}; nb_right = add_ceremony(n, is_right, e07, 6, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 7, 10, nelt, npos); PPR
+	const int e07[] = {1, 2, 3, 0, 4, 5, 6, 7, 8, 9, -1}; nb_right = add_ceremony(n, right, e07, 6, nelt, npos); PPR
 
 	TITLE("Week  8")
-	nb_right = add_new_couple(n, is_right, NO , 0, 3, nelt, npos); PPR
-	const int e08[] = {0, 9, 1, 3, 4, 2, 6, 7, 8, -1, 5}; nb_right = add_ceremony(n, is_right, e08, 6, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 0, 3, nelt, npos); PPR
+	const int e08[] = {0, 9, 1, 3, 4, 2, 6, 7, 8, -1, 5}; nb_right = add_ceremony(n, right, e08, 6, nelt, npos); PPR
 
 	TITLE("Week  9")
-	nb_right = add_new_couple(n, is_right, NO , 2, 10, nelt, npos); PPR
-	const int e09[] = {0, -1, 3, 2, 4, 5, 6, 7, 8, 9, 1}; nb_right = add_ceremony(n, is_right, e09, 7, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 2, 10, nelt, npos); PPR
+	const int e09[] = {0, -1, 3, 2, 4, 5, 6, 7, 8, 9, 1}; nb_right = add_ceremony(n, right, e09, 7, nelt, npos); PPR
 
 	TITLE("Week 10")
-	nb_right = add_new_couple(n, is_right, YES, 6, 6, nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, NO , 6, 10, nelt, npos); PPR
-	const int e10[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 9}; nb_right = add_ceremony(n, is_right, e10, 11, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 6, 6, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 6, 10, nelt, npos); PPR
+	const int e10[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 9}; nb_right = add_ceremony(n, right, e10, 11, nelt, npos); PPR
 
-	free(is_right);
+	free_right(right);
 }
 
 /* A real test, with the french's season 3 */
 void test_season_3()
 {
 	const int n = 11;            /* Number of elements and positions; we have n-1 elements in n positions */
-	const int n_arr = 199584000; /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
+	const long long n_arr = n_arrangements(n); /* Number of possible arrangements; n_arr = 1*2*3*...*n * (n-1) / 2 */
 	const char npos[][MAX_NAME+1] = {
 		"Antoine",  /* pos=0 */
 		"Ariel",    /* pos=1 */
@@ -606,55 +3462,1286 @@ void test_season_3()
 		"Mina"      /* elt=9 */
 	};
 
-	print_names(n, 1, nelt, npos);
+	print_names(n, n-1, 1, nelt, npos);
 
-	/* Init is_right[] */
+	/* Init right */
 	TITLE("Init")
-	int* is_right = init_is_right(n_arr); /* For each arrangement (size = n_arr), says if this arrangement is possible (=1) or not (=0) */
-	int nb_right = n_arr;
+	struct right* right = init_right(n); /* The set of possible arrangements */
+	long long nb_right = n_arr;
 	PPR
 
 	TITLE("Week  1")
-	nb_right = add_new_couple(n, is_right, NO , 3, 2 , nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, NO , 7, 7 , nelt, npos); PPR
-	const int e01[] = {6, 5, 4, 3, 8, 9, 7, -1, 0, 2, 1}; nb_right = add_ceremony(n, is_right, e01, 1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 3, 2 , nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 7, 7 , nelt, npos); PPR
+	const int e01[] = {6, 5, 4, 3, 8, 9, 7, -1, 0, 2, 1}; nb_right = add_ceremony(n, right, e01, 1, nelt, npos); PPR
 
 	TITLE("Week  2")
-	nb_right = add_new_couple(n, is_right, NO , 1, 10, nelt, npos); PPR
-	const int e02[] = {4, 3, 9, -1, 8, 0, 5, 6, 2, 1, 7}; nb_right = add_ceremony(n, is_right, e02, 1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 1, 10, nelt, npos); PPR
+	const int e02[] = {4, 3, 9, -1, 8, 0, 5, 6, 2, 1, 7}; nb_right = add_ceremony(n, right, e02, 1, nelt, npos); PPR
 
 	TITLE("Week  3")
-	nb_right = add_new_couple(n, is_right, YES, 4, 5 , nelt, npos); PPR
-	nb_right = add_new_couple(n, is_right, YES, 4, 9 , nelt, npos); PPR
-	const int e03[] = {6, 3, 5, 1, 8, 4, 9, 2, 0, 4, 7}; nb_right = add_ceremony(n, is_right, e03, 2+1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 4, 5 , nelt, npos); PPR
+	nb_right = add_new_couple(n, right, YES, 4, 9 , nelt, npos); PPR
+	const int e03[] = {6, 3, 5, 1, 8, 4, 9, 2, 0, 4, 7}; nb_right = add_ceremony(n, right, e03, 2+1, nelt, npos); PPR
 
 	/* Remark : do not forget the doubled match => add_ceremony(... +1 ...) */
 
 	TITLE("Week  4")
-	nb_right = add_new_couple(n, is_right, NO , 8, 3 , nelt, npos); PPR
-	const int e04[] = {5, 3, 2, 0, 1, 4, 6, 9, 8, 4, 7}; nb_right = add_ceremony(n, is_right, e04, 3+1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 8, 3 , nelt, npos); PPR
+	const int e04[] = {5, 3, 2, 0, 1, 4, 6, 9, 8, 4, 7}; nb_right = add_ceremony(n, right, e04, 3+1, nelt, npos); PPR
 
 	TITLE("Week  5")
-	nb_right = add_new_couple(n, is_right, NO , 8, 4 , nelt, npos); PPR
-	const int e05[] = {1, 3, 2, 9, 7, 4, 6, 5, 8, 4, 0}; nb_right = add_ceremony(n, is_right, e05, 2+1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 8, 4 , nelt, npos); PPR
+	const int e05[] = {1, 3, 2, 9, 7, 4, 6, 5, 8, 4, 0}; nb_right = add_ceremony(n, right, e05, 2+1, nelt, npos); PPR
 
 	TITLE("Week  6")
-	nb_right = add_new_couple(n, is_right, NO , 8, 10, nelt, npos); PPR
-	const int e06[] = {8, 3, 2, 1, 0, 4, 9, 7, 5, 4, 6}; nb_right = add_ceremony(n, is_right, e06, 2+1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 8, 10, nelt, npos); PPR
+	const int e06[] = {8, 3, 2, 1, 0, 4, 9, 7, 5, 4, 6}; nb_right = add_ceremony(n, right, e06, 2+1, nelt, npos); PPR
 
 	TITLE("Week  7")
-	nb_right = add_new_couple(n, is_right, NO , 9, 6 , nelt, npos); PPR
-	const int e07[] = {9, 1, 8, 3, 6, 4, 5, 0, 2, 4, 7}; nb_right = add_ceremony(n, is_right, e07, 2+1, nelt, npos); PPR
+	nb_right = add_new_couple(n, right, NO , 9, 6 , nelt, npos); PPR
+	const int e07[] = {9, 1, 8, 3, 6, 4, 5, 0, 2, 4, 7}; nb_right = add_ceremony(n, right, e07, 2+1, nelt, npos); PPR
+
+	free_right(right);
+}
+
+/*
+	Snapshots : the state of a season saved in a file after its events, to resume later.
+	The file contains, in the byte order of the machine :
+		the header struct snapshot_header
+		the events applied, n_events * EVENT_INTS integers of 32 bits
+		proba_right[], n*(n-1) integers of 64 bits (if has_proba)
+		some padding to a multiple of 8 bytes
+		the possible arrangements : the words of is_right (kind SNAP_BITSET), or surv[] (kind SNAP_LIST)
+	The file is mapped in memory to resume, and is_right uses it directly (copy on write),
+	so resuming costs only the reading of the pages needed.
+*/
+#define SNAPSHOT_MAGIC "AYTOSNAP"
+#define SNAPSHOT_VERSION 3 /* 2 : the ranks of the plain changes order, 3 : the counts in 64 bits */
+#define SNAP_BITSET 0 /* The arrangements are the bitset is_right */
+#define SNAP_LIST   1 /* The arrangements are the list surv[] */
+#define EVENT_INTS (5+MAX_N) /* Number of integers of an event in a snapshot */
+
+struct snapshot_header {
+	char magic[8];     /* SNAPSHOT_MAGIC */
+	int32_t version;   /* SNAPSHOT_VERSION */
+	int32_t n;         /* Number of positions */
+	int64_t n_arr;     /* Number of arrangements */
+	int64_t nb_right;  /* Number of possible arrangements */
+	int32_t kind;      /* SNAP_BITSET or SNAP_LIST */
+	int32_t n_events;  /* Number of events applied */
+	int32_t has_proba; /* YES if proba_right[] is saved */
+	int32_t unused;    /* 0 (the header is a multiple of 8 bytes) */
+};
+
+/* Offset of the possible arrangements in a snapshot */
+size_t snapshot_data_offset(const struct snapshot_header* h)
+{
+	size_t offset = sizeof(struct snapshot_header)
+		+ (size_t)h->n_events * EVENT_INTS * sizeof(int32_t)
+		+ (h->has_proba ? (size_t)h->n * (h->n-1) * sizeof(int64_t) : 0);
+	return (offset + 7) / 8 * 8;
+}
+
+/* Returns YES if the events a and b for n positions are the same */
+int same_event(int n, const struct event* a, const struct event* b)
+{
+	int i;
+	if(a->type != b->type)
+		return NO;
+	if(a->type == EV_DOUBLON)
+		return a->pos == b->pos;
+	if(a->type == EV_COUPLE)
+		return a->elt == b->elt && a->pos == b->pos && a->couple == b->couple;
+	for(i=0 ; i<n ; i++)
+		if(a->a_elt[i] != b->a_elt[i])
+			return NO;
+	return a->matches == b->matches;
+}
+
+/* Writes size bytes of data to f, or stops the program */
+void write_or_die(FILE* f, const void* data, size_t size, const char* file)
+{
+	if(size > 0 && fwrite(data, size, 1, f) != 1) {
+		fprintf(stderr, "error : fwrite() : %s\n", file);
+		exit(1);
+	}
+}
+
+/* Saves right and the n_ev events evs[] applied to it into the snapshot file
+	(written in file.tmp, then renamed, so the previous snapshot stays valid until the end)
+*/
+void save_snapshot(const char* file, int n, const struct right* right, const struct event* evs, int n_ev)
+{
+	int i, j;
+	struct snapshot_header h;
+	char* tmp = (char*)malloc(strlen(file) + 5);
+	if(!tmp) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	sprintf(tmp, "%s.tmp", file);
+	FILE* f = fopen(tmp, "wb");
+	if(!f) {
+		fprintf(stderr, "error : fopen() : %s\n", tmp);
+		exit(1);
+	}
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, 8);
+	h.version = SNAPSHOT_VERSION;
+	h.n = n;
+	h.n_arr = right->n_arr;
+	h.nb_right = right->nb_right;
+	h.kind = right->surv ? SNAP_LIST : SNAP_BITSET;
+	h.n_events = n_ev;
+	h.has_proba = YES; /* Always, since proba_right[] is kept up to date */
+	write_or_die(f, &h, sizeof(h), tmp);
+	for(i=0 ; i<n_ev ; i++) {
+		int32_t t[EVENT_INTS];
+		t[0] = evs[i].type;
+		t[1] = evs[i].couple;
+		t[2] = evs[i].elt;
+		t[3] = evs[i].pos;
+		t[4] = evs[i].matches;
+		for(j=0 ; j<MAX_N ; j++)
+			t[5+j] = j<n ? evs[i].a_elt[j] : 0;
+		write_or_die(f, t, sizeof(t), tmp);
+	}
+	if(h.has_proba)
+		for(i=0 ; i<n*(n-1) ; i++) {
+			const int64_t count = right->proba_right[i];
+			write_or_die(f, &count, sizeof(count), tmp);
+		}
+	const size_t pad = snapshot_data_offset(&h) - (size_t)ftell(f);
+	const uint64_t zero = 0;
+	write_or_die(f, &zero, pad, tmp);
+	if(right->surv)
+		write_or_die(f, right->surv, (size_t)right->nb_right * sizeof(uint64_t), tmp);
+	else
+		write_or_die(f, right->is_right->words, (size_t)right->is_right->n_words * sizeof(uint64_t), tmp);
+	if(fclose(f) != 0 || rename(tmp, file) != 0) {
+		fprintf(stderr, "error : cannot write %s\n", file);
+		exit(1);
+	}
+	free(tmp);
+}
+
+/* Loads the snapshot file for n positions : returns the possible arrangements,
+	and sets *evs (to free) and *n_ev to the events already applied,
+	or returns NULL if the file does not exist
+*/
+struct right* load_snapshot(const char* file, int n, struct event** evs, int* n_ev)
+{
+	int i, j;
+	struct stat st;
+	const int fd = open(file, O_RDONLY);
+	if(fd < 0)
+		return NULL;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct snapshot_header)) {
+		fprintf(stderr, "error : %s is not a snapshot\n", file);
+		exit(1);
+	}
+	void* map = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		fprintf(stderr, "error : mmap() : %s\n", file);
+		exit(1);
+	}
+	const struct snapshot_header* h = (const struct snapshot_header*)map;
+	if(memcmp(h->magic, SNAPSHOT_MAGIC, 8) != 0 || h->version != SNAPSHOT_VERSION || !h->has_proba) {
+		fprintf(stderr, "error : %s is not a snapshot of version %d\n", file, SNAPSHOT_VERSION);
+		exit(1);
+	}
+	const size_t data = snapshot_data_offset(h);
+	const size_t n_words = h->kind == SNAP_LIST ? (size_t)h->nb_right : ((size_t)h->n_arr + 63) / 64;
+	if(h->n != n || h->n_arr != n_arrangements(n) || data + n_words * sizeof(uint64_t) != (size_t)st.st_size) {
+		fprintf(stderr, "error : the snapshot %s does not match this season\n", file);
+		exit(1);
+	}
+
+	/* The events already applied */
+	const int32_t* t = (const int32_t*)((const char*)map + sizeof(struct snapshot_header));
+	*n_ev = h->n_events;
+	*evs = (struct event*)malloc((h->n_events > 0 ? h->n_events : 1) * sizeof(struct event));
+	if(!*evs) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	for(i=0 ; i<h->n_events ; i++, t+=EVENT_INTS) {
+		(*evs)[i].type = t[0];
+		(*evs)[i].couple = t[1];
+		(*evs)[i].elt = t[2];
+		(*evs)[i].pos = t[3];
+		(*evs)[i].matches = t[4];
+		for(j=0 ; j<MAX_N ; j++)
+			(*evs)[i].a_elt[j] = t[5+j];
+	}
+
+	/* The possible arrangements */
+	struct right* right = (struct right*)malloc(sizeof(struct right));
+	if(!right) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	right->n_arr = h->n_arr;
+	right->nb_right = h->nb_right;
+	right->proba_right = new_counts(n*(n-1));
+	for(i=0 ; i<n*(n-1) ; i++) { /* Not aligned on 8 bytes after an odd number of events */
+		int64_t count;
+		memcpy(&count, t + 2*i, sizeof(count));
+		right->proba_right[i] = count;
+	}
+	right->map = map;
+	right->map_size = (size_t)st.st_size;
+	right->is_right = NULL;
+	right->spill = NULL;
+	right->surv = NULL;
+	if(h->kind == SNAP_LIST) { /* The list is small : copy it, so it can be freed as usual */
+		right->surv = new_codes(h->nb_right);
+		memcpy(right->surv, (const char*)map + data, n_words * sizeof(uint64_t));
+	} else {
+		right->is_right = (struct bitset*)malloc(sizeof(struct bitset));
+		if(!right->is_right) {
+			fprintf(stderr, "error : malloc()\n");
+			exit(1);
+		}
+		right->is_right->n_bits = h->n_arr;
+		right->is_right->n_words = (long long)n_words;
+		right->is_right->words = (uint64_t*)((char*)map + data);
+		right->is_right->mapped = YES;
+		right->is_right->first = 0;
+	}
+	return right;
+}
+
+/*
+	Event logs : a season in a text file, read line by line.
+	Each line is a command, and # starts a comment :
+		positions girls Daisie Hilona ...       the group of positions and their names (n positions)
+		elements boys Nicolas Selim ...         the group of elements and their names (n-1 elements, or m with m <= n <= 2*m)
+		title Week  1                           prints a title
+		doublon Melanie                         the position known as the doublon
+		booth Sergio Marilou no                 a truth booth : element, position, yes or no
+		ceremony 1 Jeremy Illan ... Tom -       a ceremony : the matches, then the element of each position (- if alone)
+		print                                   prints the probabilities
+		count                                   prints the number of possible arrangements
+		booths                                  prints the information expected from each truth booth
+		lineup                                  proposes the ceremony that gives the most information
+		undo                                    cancels the last events applied (see serve_commands())
+	Elements and positions are given by name or by number.
+	With n-1 elements, one element has two positions ; with m elements, n-m elements have two positions each,
+	and the arrangements are then counted by dynamic programming (--dp, or --backtrack), or estimated (--sample).
+	Events are applied when the probabilities are printed, all together in one review,
+	and the probabilities are printed at the end if the last events have not been printed.
+	With print_all, the events are applied one by one, and the probabilities are printed after each event.
+*/
+#define MAX_LINE 1024 /* Max size of a line of an event log */
+#define NAMES(t) ((const char (*)[MAX_NAME+1])(t)) /* Names, as expected by the print functions */
+
+/* A season read from an event log */
+struct season {
+	int n;                            /* Number of positions, 0 until both names are known */
+	int n_pos, n_elt;                 /* Number of names of positions and elements read */
+	int gender;                       /* 0 if the positions are girls, 1 if they are boys */
+	char npos[MAX_N][MAX_NAME+1];     /* Names of the positions */
+	char nelt[MAX_N][MAX_NAME+1];     /* Names of the elements */
+	struct right* right;              /* The possible arrangements, or NULL with backtracking */
+	long long nb_right;               /* Number of possible arrangements */
+	struct event* log;                /* All events read (size = max_log) */
+	int n_log, max_log;               /* Number of events read, and allocated */
+	int n_pending;                    /* Number of the last events not applied yet */
+	int printed;                      /* YES if the probabilities have been printed since the last event */
+	int print_all;                    /* YES to print the probabilities after each event */
+	int backtrack;                    /* COUNT_BACKTRACK or COUNT_DP to count the arrangements instead of reviewing them, or NO */
+	int sample;                       /* YES to estimate by Monte Carlo instead of reviewing the arrangements */
+	const char* snapshot;             /* The snapshot file saved after the events are applied, or NULL */
+	int n_resumed;                    /* Number of the first events of log already applied, loaded from the snapshot */
+	int serve;                        /* YES in server mode : the events are applied at once, and can be cancelled */
+	int collect;                      /* YES to only read the names and the events, with no print (see run_scenarios()) */
+	struct delta** undo;              /* The deltas of the events applied, to cancel them (size = max_undo) */
+	int n_undo, max_undo;             /* Number of deltas, and allocated */
+};
+
+jmp_buf* log_error_jump = NULL; /* Where log_error() goes back in server mode, or NULL to stop the program */
+
+/* Stops the program with an error at line line_no
+	(in server mode, only the command is stopped, and the error is also the answer)
+*/
+void log_error(int line_no, const char* message, const char* token)
+{
+	fprintf(stderr, "error : line %d : %s%s%s\n", line_no, message, token ? " : " : "", token ? token : "");
+	if(log_error_jump != NULL) {
+		fprintf(stdout, "error : %s%s%s\n", message, token ? " : " : "", token ? token : "");
+		longjmp(*log_error_jump, 1);
+	}
+	exit(1);
+}
+
+/* Returns the number of name among the n_names names[], or the number given as is */
+int find_name(const char* name, const char names[][MAX_NAME+1], int n_names, int line_no)
+{
+	int i;
+	char* end;
+	for(i=0 ; i<n_names ; i++)
+		if(strcmp(name, names[i]) == 0)
+			return i;
+	i = (int)strtol(name, &end, 10);
+	if(*end != '\0' || end == name || i < 0 || i >= n_names)
+		log_error(line_no, "unknown name", name);
+	return i;
+}
+
+/* Applies the pending events of the season */
+void season_apply(struct season* se)
+{
+	struct delta* d = NULL;
+	const struct event* evs = se->log + se->n_log - se->n_pending;
+	if(se->n_pending == 0)
+		return;
+	if(se->right != NULL && se->serve)
+		d = apply_events_undoable(se->n, se->right, evs, se->n_pending);
+	else if(se->right != NULL)
+		apply_events(se->n, se->right, evs, se->n_pending);
+	if(se->right != NULL)
+		se->nb_right = se->right->nb_right;
+	if(se->serve) { /* Keep the delta (with backtracking, only the number of events) */
+		if(d == NULL && (d = (struct delta*)calloc(1, sizeof(struct delta))) == NULL) {
+			fprintf(stderr, "error : calloc()\n");
+			exit(1);
+		}
+		d->n_ev = se->n_pending;
+		if(se->n_undo == se->max_undo) {
+			se->max_undo = 2*se->max_undo + 16;
+			se->undo = (struct delta**)realloc(se->undo, se->max_undo * sizeof(struct delta*));
+			if(!se->undo) {
+				fprintf(stderr, "error : realloc()\n");
+				exit(1);
+			}
+		}
+		se->undo[se->n_undo++] = d;
+	}
+	se->n_pending = 0;
+	if(se->snapshot != NULL)
+		save_snapshot(se->snapshot, se->n, se->right, se->log, se->n_log);
+}
+
+/* Prints the current probabilities of the season */
+void season_print(struct season* se)
+{
+	season_apply(se);
+	if(se->backtrack)
+		print_proba_backtrack(se->backtrack, se->n, se->n_elt, se->log, se->n_log, NAMES(se->nelt), NAMES(se->npos));
+	else if(se->sample)
+		print_proba_sample(se->n, se->n_elt, se->log, se->n_log, NAMES(se->nelt), NAMES(se->npos));
+	else
+		print_proba_right(se->n, se->right, se->nb_right, NAMES(se->nelt), NAMES(se->npos));
+	se->printed = YES;
+}
+
+/* Cancels the last events applied together (one event in server mode) */
+void season_undo(struct season* se, int line_no)
+{
+	season_apply(se);
+	if(se->n_undo == 0)
+		log_error(line_no, "nothing to undo", NULL);
+	struct delta* d = se->undo[--se->n_undo];
+	const int n_ev = d->n_ev;
+	se->n_log -= n_ev;
+	if(se->right != NULL)
+		se->nb_right = undo_events(se->right, d);
+	else
+		free_delta(d);
+	se->printed = NO;
+	if(se->snapshot != NULL)
+		save_snapshot(se->snapshot, se->n, se->right, se->log, se->n_log);
+	fprintf(stdout, "%d event%s cancelled\n", n_ev, n_ev > 1 ? "s" : "");
+}
+
+/* Prints the expected information of each truth booth (see print_booth_gains()) */
+void season_booths(struct season* se, int line_no)
+{
+	int i;
+	const int nsq = se->n * se->n_elt;
+	long long nb_right;
+	season_apply(se);
+	if(se->sample)
+		log_error(line_no, "booths needs exact counts (no --sample)", NULL);
+	long long* proba_right = new_counts(nsq); /* After the checks : log_error() may not return (see serve_line()) */
+	if(se->backtrack)
+		count_exact(se->backtrack, se->n, se->n_elt, se->log, se->n_log, &nb_right, proba_right);
+	else {
+		nb_right = se->nb_right;
+		for(i=0 ; i<nsq ; i++)
+			proba_right[i] = se->right->proba_right[i];
+	}
+	print_booth_gains(se->n, se->n_elt, nb_right, proba_right, NAMES(se->nelt), NAMES(se->npos));
+	free(proba_right);
+}
+
+/* Prints the lineup proposed for the next ceremony (see search_lineup()) */
+void season_lineup(struct season* se, int line_no)
+{
+	int i, n_codes, a_elt[MAX_N], hist[MAX_N+1];
+	long long n_scored;
+	season_apply(se);
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	if(se->right == NULL)
+		log_error(line_no, "lineup needs the arrangements (no --backtrack, --dp or --sample)", NULL);
+	if(se->nb_right == 0)
+		log_error(line_no, "no possible arrangement", NULL);
+	const double gain = search_lineup(se->n, se->right, time_budget, a_elt, hist, &n_codes, &n_scored);
+	fprintf(stdout, "Proposed ceremony (%5.3f bits expected, on %d arrangements) :\nceremony ?", gain, n_codes);
+	for(i=0 ; i<se->n ; i++)
+		fprintf(stdout, " %s", a_elt[i] < 0 ? "-" : se->nelt[a_elt[i]]);
+	fprintf(stdout, "\nMatches :");
+	for(i=0 ; i<se->n ; i++)
+		if(hist[i] > 0)
+			fprintf(stdout, "  %d : %4.1f%%", i, 100 * (double)hist[i] / n_codes);
+	fprintf(stdout, "\n\n");
+	fflush(stdout);
+	stats_record("lineup", "annealing", wall0, cpu0, ",\"arrangements\":%d,\"scored\":%lld,\"bits\":%.4f", n_codes, n_scored, gain);
+}
+
+/* Prints the current number of possible arrangements of the season */
+void season_count(struct season* se, int line_no)
+{
+	long long nb_right;
+	season_apply(se);
+	if(se->sample)
+		log_error(line_no, "count needs exact counts (no --sample)", NULL);
+	if(se->backtrack) {
+		long long* proba_right = new_counts(se->n * se->n_elt);
+		count_exact(se->backtrack, se->n, se->n_elt, se->log, se->n_log, &nb_right, proba_right);
+		free(proba_right);
+	} else
+		nb_right = se->nb_right;
+	fprintf(stdout, "%lld possible arrangements\n", nb_right);
+}
+
+/* Reads the names of a line "positions ..." or "elements ..." */
+void season_names(struct season* se, char names[][MAX_NAME+1], int* n_names, int line_no)
+{
+	char* token;
+	if(se->n)
+		log_error(line_no, "names already known", NULL);
+	if(strtok(NULL, " \t") == NULL) /* The group, for example girls */
+		log_error(line_no, "missing group", NULL);
+	for(*n_names=0 ; (token = strtok(NULL, " \t")) != NULL ; (*n_names)++) {
+		if(*n_names == MAX_N)
+			log_error(line_no, "too many names", NULL);
+		if(strlen(token) > MAX_NAME)
+			log_error(line_no, "name too long", token);
+		strcpy(names[*n_names], token);
+	}
+}
+
+/* Reads the line line_no of an event log */
+void season_line(struct season* se, char* line, int line_no)
+{
+	int i;
+	char* token;
+	char* end;
+	struct event ev;
+	memset(&ev, 0, sizeof(ev));
+	line[strcspn(line, "#\r\n")] = '\0'; /* Remove comments and end of line */
+	if((token = strtok(line, " \t")) == NULL) /* Empty line */
+		return;
+
+	if(strcmp(token, "positions") == 0 || strcmp(token, "elements") == 0) {
+		const int is_pos = (token[0] == 'p');
+		if(is_pos) {
+			char* group = token + strlen(token) + 1; /* Peek the group before season_names() reads it */
+			group += strspn(group, " \t");
+			se->gender = (strncmp(group, "boys", 4) == 0);
+		}
+		season_names(se, is_pos ? se->npos : se->nelt, is_pos ? &se->n_pos : &se->n_elt, line_no);
+		if(se->n_pos && se->n_elt) { /* Both names known : start */
+			if(se->n_elt > se->n_pos || se->n_pos > 2*se->n_elt || se->n_elt >= MAX_N || se->n_pos < 2)
+				log_error(line_no, "the number of positions must be between the number of elements and its double", NULL);
+			se->n = se->n_pos;
+			if(se->collect) /* Only the events are needed */
+				return;
+			print_names(se->n, se->n_elt, se->gender, NAMES(se->nelt), NAMES(se->npos));
+			if(se->n_elt != se->n-1) { /* Only counted, position by position */
+				if(se->snapshot != NULL)
+					log_error(line_no, "--snapshot needs n-1 elements", NULL);
+				if(!se->backtrack && !se->sample) {
+					fprintf(stderr, "%d elements in %d positions : counted with --dp\n\n", se->n_elt, se->n);
+					se->backtrack = COUNT_DP;
+				}
+			}
+			if(!se->backtrack && !se->sample && n_arrangements(se->n) > MAX_REVIEW && spill_dir == NULL)
+				log_error(line_no, "too many arrangements to review, use --spill, --dp, --backtrack or --sample", NULL);
+			se->nb_right = n_arrangements_of(se->n, se->n_elt);
+			if(se->snapshot != NULL && (se->right = load_snapshot(se->snapshot, se->n, &se->log, &se->n_resumed)) != NULL) {
+				se->nb_right = se->right->nb_right;
+				se->max_log = se->n_resumed;
+				fprintf(stderr, "Resume from %s after %d events\n\n", se->snapshot, se->n_resumed);
+			} else if(!se->backtrack && !se->sample)
+				se->right = init_right(se->n);
+		}
+		return;
+	}
+	if(se->n_log < se->n_resumed && (strcmp(token, "title") == 0 || strcmp(token, "print") == 0))
+		return; /* Before the end of the snapshot, nothing to print */
+	if(se->collect && strcmp(token, "undo") == 0)
+		log_error(line_no, "undo needs the events applied, not in a scenario", NULL);
+	if(se->collect && (strcmp(token, "title") == 0 || strcmp(token, "print") == 0 || strcmp(token, "count") == 0
+			|| strcmp(token, "booths") == 0 || strcmp(token, "lineup") == 0))
+		return; /* Only the events */
+	if(strcmp(token, "title") == 0) {
+		token = strtok(NULL, "");
+		TITLE(token ? token + strspn(token, " \t") : "")
+		return;
+	}
+	if(se->n == 0)
+		log_error(line_no, "positions and elements must come first", token);
+	if(strcmp(token, "print") == 0) {
+		season_print(se);
+		return;
+	}
+	if(strcmp(token, "count") == 0) {
+		season_count(se, line_no);
+		return;
+	}
+	if(strcmp(token, "booths") == 0) {
+		season_booths(se, line_no);
+		return;
+	}
+	if(strcmp(token, "lineup") == 0) {
+		season_lineup(se, line_no);
+		return;
+	}
+	if(strcmp(token, "undo") == 0) {
+		season_undo(se, line_no);
+		return;
+	}
+
+	/* An event */
+	if(strcmp(token, "doublon") == 0) {
+		ev.type = EV_DOUBLON;
+		if((token = strtok(NULL, " \t")) == NULL)
+			log_error(line_no, "missing position", NULL);
+		ev.pos = find_name(token, NAMES(se->npos), se->n, line_no);
+		if(se->n_elt == se->n)
+			log_error(line_no, "no doublon with as many elements as positions", NULL);
+	} else if(strcmp(token, "booth") == 0) {
+		ev.type = EV_COUPLE;
+		char* elt = strtok(NULL, " \t");
+		char* pos = strtok(NULL, " \t");
+		char* couple = strtok(NULL, " \t");
+		if(couple != NULL && strcmp(couple, "yes") == 0)
+			ev.couple = YES;
+		else if(couple != NULL && strcmp(couple, "no") == 0)
+			ev.couple = NO;
+		else /* Anything else is a typo, not a "no" */
+			log_error(line_no, "expected : booth element position yes|no", couple);
+		ev.elt = find_name(elt, NAMES(se->nelt), se->n_elt, line_no);
+		ev.pos = find_name(pos, NAMES(se->npos), se->n, line_no);
+	} else if(strcmp(token, "ceremony") == 0) {
+		ev.type = EV_CEREMONY;
+		if((token = strtok(NULL, " \t")) == NULL)
+			log_error(line_no, "missing matches", NULL);
+		ev.matches = (int)strtol(token, &end, 10);
+		if(end == token || *end != '\0' || ev.matches < 0 || ev.matches > se->n)
+			log_error(line_no, "the matches must be a number from 0 to the number of positions", token);
+		for(i=0 ; i<se->n ; i++) {
+			if((token = strtok(NULL, " \t")) == NULL)
+				log_error(line_no, "expected one element for each position", NULL);
+			ev.a_elt[i] = (strcmp(token, "-") == 0) ? -1 : find_name(token, NAMES(se->nelt), se->n_elt, line_no);
+		}
+	} else
+		log_error(line_no, "unknown command", token);
+	if(strtok(NULL, " \t") != NULL)
+		log_error(line_no, "too many words", NULL);
+	if(se->n_log < se->n_resumed) { /* Already applied in the snapshot */
+		if(!same_event(se->n, &ev, &se->log[se->n_log]))
+			log_error(line_no, "this event is not the one of the snapshot", NULL);
+		se->n_log++;
+		return;
+	}
+
+	if(se->n_log == se->max_log) {
+		se->max_log = 2*se->max_log + 16;
+		se->log = (struct event*)realloc(se->log, se->max_log * sizeof(struct event));
+		if(!se->log) {
+			fprintf(stderr, "error : realloc()\n");
+			exit(1);
+		}
+	}
+	se->log[se->n_log++] = ev;
+	se->n_pending++;
+	se->printed = NO;
+	if(se->collect)
+		return;
+	print_event(se->n, &ev, NAMES(se->nelt), NAMES(se->npos));
+	if(se->print_all)
+		season_print(se);
+	else if(se->serve)
+		season_apply(se);
+}
+
+/* Runs the command line of a season in server mode, and answers ok, or the error */
+void serve_line(struct season* se, char* line, int line_no)
+{
+	jmp_buf jump;
+	if(setjmp(jump) == 0) {
+		log_error_jump = &jump;
+		season_line(se, line, line_no);
+		fprintf(stdout, "ok\n");
+	}
+	log_error_jump = NULL;
+	fflush(stdout);
+}
+
+/*
+	Server mode : the season stays in memory, and the commands are read from f, one by line.
+	The commands are the ones of the event logs (see season_line()), and each answer ends with
+	a line "ok" or "error : ...". Each event is applied at once, and can be cancelled by undo
+	with no review (see apply_events_undoable()). The session ends with quit, or at the end of f,
+	and stop also stops the server.
+	Returns YES if the server must stop.
+*/
+int serve_commands(struct season* se, FILE* f)
+{
+	char line[MAX_LINE];
+	int line_no = 0;
+	while(fgets(line, sizeof(line), f) != NULL) {
+		line_no++;
+		line[strcspn(line, "\r\n")] = '\0';
+		if(strcmp(line, "quit") == 0 || strcmp(line, "stop") == 0) { /* The whole line : "stopwatch" is not a stop */
+			fprintf(stdout, "ok\n");
+			fflush(stdout);
+			return line[0] == 's';
+		}
+		serve_line(se, line, line_no);
+	}
+	return NO;
+}
+
+/* Server mode on the local (Unix) socket path : each connection is a session of serve_commands(),
+	answered on the same connection
+*/
+void serve_socket(struct season* se, const char* path)
+{
+	struct sockaddr_un addr;
+	int stop = NO;
+	const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(fd < 0 || strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "error : socket() : %s\n", path);
+		exit(1);
+	}
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+		fprintf(stderr, "error : bind() : %s\n", path);
+		exit(1);
+	}
+	signal(SIGPIPE, SIG_IGN); /* A client may leave before its answer */
+	const int out = dup(1);
+	while(!stop) {
+		const int conn = accept(fd, NULL, NULL);
+		if(conn < 0)
+			continue;
+		FILE* f = fdopen(conn, "r");
+		fflush(stdout);
+		dup2(conn, 1); /* The answers go to the client */
+		stop = serve_commands(se, f);
+		fflush(stdout);
+		dup2(out, 1);
+		fclose(f);
+	}
+	close(out);
+	close(fd);
+	unlink(path);
+}
+
+/* Reads a whole event log from f, and prints the probabilities
+	With a snapshot file, the state is saved after the events are applied,
+	and if the snapshot exists, the events already applied in it are not applied again
+	With serve, the season then stays in memory for the commands read
+	from the standard input (serve is -), or from the local socket serve (see serve_commands());
+	f can then be NULL, to start with no event
+*/
+void run_event_log(FILE* f, int print_all, int backtrack, int sample, const char* snapshot, const char* serve)
+{
+	int i;
+	char line[MAX_LINE];
+	int line_no = 0;
+	struct season se;
+	memset(&se, 0, sizeof(se));
+	se.print_all = print_all;
+	se.backtrack = backtrack;
+	se.sample = sample;
+	se.snapshot = snapshot;
+	se.serve = serve != NULL;
+	while(f != NULL && fgets(line, sizeof(line), f) != NULL)
+		season_line(&se, line, ++line_no);
+	if(serve != NULL) {
+		season_apply(&se);
+		fflush(stdout);
+		if(strcmp(serve, "-") == 0)
+			serve_commands(&se, stdin);
+		else
+			serve_socket(&se, serve);
+	} else if(se.n == 0)
+		log_error(line_no, "positions and elements are missing", NULL);
+	if(se.n_log < se.n_resumed)
+		log_error(line_no, "the snapshot has more events than the event log", NULL);
+	if(!se.printed && serve == NULL)
+		season_print(&se);
+	for(i=0 ; i<se.n_undo ; i++)
+		free_delta(se.undo[i]);
+	free(se.undo);
+	if(se.right)
+		free_right(se.right);
+	free(se.log);
+}
+
+/*
+	Scenarios : several variants of a season (a disputed number of matches, another answer of a truth booth...),
+	each in its own event log with the same positions and elements, reviewed together in one sweep
+	(see scenario_chunk()) : each arrangement is generated once for all of them, and each scenario keeps
+	its own possible arrangements and counts. All events of a scenario are applied at once,
+	then the probabilities of each scenario are printed, in the order of the files.
+*/
+
+/* Reads the names and the events of the event log file into se (see season->collect), and returns its number of lines */
+int read_events(struct season* se, const char* file)
+{
+	char line[MAX_LINE];
+	int line_no = 0;
+	FILE* f = fopen(file, "r");
+	if(!f) {
+		fprintf(stderr, "error : fopen() : %s\n", file);
+		exit(1);
+	}
+	se->collect = YES;
+	while(fgets(line, sizeof(line), f) != NULL)
+		season_line(se, line, ++line_no);
+	fclose(f);
+	if(se->n == 0)
+		log_error(line_no, "positions and elements are missing", file);
+	if(se->n_elt != se->n-1)
+		log_error(line_no, "the arrangements are reviewed with n-1 elements", file);
+	return line_no;
+}
+
+/* Reads the n_scen event logs files[], reviews them together, and prints the probabilities of each one */
+void run_scenarios(const char** files, int n_scen)
+{
+	int i, k, n = 0;
+	struct season* se = (struct season*)calloc(n_scen, sizeof(struct season));
+	struct predicate* preds = (struct predicate*)malloc(n_scen * sizeof(struct predicate));
+	struct bitset** bits = (struct bitset**)malloc(n_scen * sizeof(struct bitset*));
+	if(!se || !preds || !bits) {
+		fprintf(stderr, "error : malloc()\n");
+		exit(1);
+	}
+	for(k=0 ; k<n_scen ; k++) { /* Read the events */
+		const int line_no = read_events(&se[k], files[k]);
+		if(k > 0 && se[k].n != n)
+			log_error(line_no, "the scenarios must have the same number of positions", files[k]);
+		n = se[k].n;
+		if(n_arrangements(n) > MAX_REVIEW)
+			log_error(line_no, "too many arrangements to review", files[k]);
+	}
+
+	/* One sweep for all */
+	const int nsq = n * (n-1);
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	long long* nb_right = new_counts(n_scen);
+	long long* proba_right = new_counts((long long)nsq * n_scen);
+	struct sweep sw;
+	for(k=0 ; k<n_scen ; k++) {
+		compile_events(n, &preds[k], se[k].log, se[k].n_log);
+		bits[k] = new_bitset(n_arrangements(n));
+	}
+	sw.n = n;
+	sw.is_right = NULL;
+	sw.pred = NULL;
+	sw.n_scen = n_scen;
+	sw.scen_right = bits;
+	sw.scen_pred = preds;
+	run_workers(&sw, proba_right, nb_right);
+	stats_record("review", "scenarios", wall0, cpu0, ",\"scenarios\":%d,\"tested\":%lld", n_scen, n_arrangements(n));
+
+	for(k=0 ; k<n_scen ; k++) {
+		TITLE(files[k])
+		print_names(n, n-1, se[k].gender, NAMES(se[k].nelt), NAMES(se[k].npos));
+		for(i=0 ; i<se[k].n_log ; i++)
+			print_event(n, &se[k].log[i], NAMES(se[k].nelt), NAMES(se[k].npos));
+		print_proba(n, n-1, nb_right[k], n_arrangements(n), proba_right + (long long)k*nsq, NAMES(se[k].nelt), NAMES(se[k].npos));
+		free_predicate(&preds[k]);
+		free_bitset(bits[k]);
+		free(se[k].log);
+	}
+	free(nb_right);
+	free(proba_right);
+	free(bits);
+	free(preds);
+	free(se);
+}
+
+/*
+	Shards : a big review (n = 12) cut between several processes, on the same machine or not.
+	The shard i of N reviews the arrangements of ranks from about n_arr * i / N to n_arr * (i+1) / N
+	(cut at a multiple of 64), with all the events of the event log applied at once,
+	a window at a time (see new_window()), and writes its counts in a shard file.
+	The cut only depends on n and N, so a shard can be run again alone if it failed.
+	Then --merge adds the counts of the N shard files, and prints the probabilities as print_proba_right().
+	A shard file is a struct shard_header, followed by the counts proba_right[] (n*(n-1) int64).
+*/
+#define SHARD_MAGIC   "AYTOSHRD"
+#define SHARD_VERSION 1
+
+struct shard_header {
+	char magic[8];                 /* SHARD_MAGIC */
+	int32_t version;               /* SHARD_VERSION */
+	int32_t n;                     /* Number of positions */
+	int32_t shard, n_shards;       /* This is the shard shard of n_shards */
+	uint64_t events;               /* Hash of the events (see hash_events()), so only the shards of one season are merged */
+	int64_t n_arr;                 /* Number of arrangements */
+	int64_t nb_right;              /* Number of possible arrangements of this shard */
+	char npos[MAX_N][MAX_NAME+1];  /* Names of the positions */
+	char nelt[MAX_N][MAX_NAME+1];  /* Names of the elements */
+};
+
+/* Hash (FNV-1a) of the n_ev events evs[] of n positions */
+uint64_t hash_events(int n, const struct event* evs, int n_ev)
+{
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for(int i=0 ; i<n_ev ; i++) {
+		int32_t t[EVENT_INTS];
+		t[0] = evs[i].type;
+		t[1] = evs[i].couple;
+		t[2] = evs[i].elt;
+		t[3] = evs[i].pos;
+		t[4] = evs[i].matches;
+		for(int j=0 ; j<MAX_N ; j++)
+			t[5+j] = j<n ? evs[i].a_elt[j] : 0;
+		for(size_t b=0 ; b<sizeof(t) ; b++)
+			h = (h ^ ((const unsigned char*)t)[b]) * 0x100000001B3ULL;
+	}
+	return h;
+}
+
+/* Reviews the shard shard of n_shards of the event log file, and writes its counts in the shard file out */
+void run_shard(const char* file, int shard, int n_shards, const char* out)
+{
+	int i;
+	struct season se;
+	struct predicate pred;
+	struct shard_header h;
+	struct sweep sw;
+	memset(&se, 0, sizeof(se));
+	read_events(&se, file);
+	const int n = se.n, nsq = n * (n-1);
+	const long long n_arr = n_arrangements(n), n_words = (n_arr + 63) / 64;
+	const long long w0 = n_words * shard / n_shards, w1 = n_words * (shard+1) / n_shards;
+	const double wall0 = now_seconds(), cpu0 = cpu_seconds();
+	long long nb_right = 0;
+	long long* proba_right = new_counts(nsq);
+	struct bitset* bs = new_window();
+	compile_events(n, &pred, se.log, se.n_log);
+	sw.n = n;
+	sw.is_right = NULL;
+	sw.pred = NULL;
+	sw.n_scen = 1;
+	sw.scen_right = &bs;
+	sw.scen_pred = &pred;
+	for(long long w=w0 ; w<w1 ; w+=SPILL_WINDOW*CHUNK_WORDS) { /* All arrangements of the window are possible before the events */
+		bs->first = 64*w;
+		bs->n_words = w1 - w < SPILL_WINDOW*CHUNK_WORDS ? w1 - w : SPILL_WINDOW*CHUNK_WORDS;
+		bs->n_bits = (64*(w + bs->n_words) < n_arr ? 64*(w + bs->n_words) : n_arr) - bs->first;
+		for(i=0 ; i<bs->n_words ; i++)
+			bs->words[i] = ~(uint64_t)0;
+		if(bs->n_bits % 64) /* Clear the unused bits of the last word */
+			bs->words[bs->n_words-1] = ((uint64_t)1 << (bs->n_bits % 64)) - 1;
+		run_workers(&sw, proba_right, &nb_right);
+	}
+	stats_record("review", "shard", wall0, cpu0, ",\"shard\":%d,\"shards\":%d,\"tested\":%lld,\"after\":%lld",
+		shard, n_shards, w1 > w0 ? (w1 * 64 < n_arr ? w1 * 64 : n_arr) - 64 * w0 : 0, nb_right);
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SHARD_MAGIC, 8);
+	h.version = SHARD_VERSION;
+	h.n = n;
+	h.shard = shard;
+	h.n_shards = n_shards;
+	h.events = hash_events(n, se.log, se.n_log);
+	h.n_arr = n_arr;
+	h.nb_right = nb_right;
+	memcpy(h.npos, se.npos, sizeof(h.npos));
+	memcpy(h.nelt, se.nelt, sizeof(h.nelt));
+	FILE* f = fopen(out, "wb");
+	if(!f) {
+		fprintf(stderr, "error : fopen() : %s\n", out);
+		exit(1);
+	}
+	write_or_die(f, &h, sizeof(h), out);
+	for(i=0 ; i<nsq ; i++) {
+		const int64_t count = proba_right[i];
+		write_or_die(f, &count, sizeof(count), out);
+	}
+	if(fclose(f) != 0) {
+		fprintf(stderr, "error : cannot write %s\n", out);
+		exit(1);
+	}
+	fprintf(stderr, "Shard %d / %d : %lld possible arrangements, in %s\n", shard, n_shards, nb_right, out);
+	free_predicate(&pred);
+	free_bitset(bs);
+	free(proba_right);
+	free(se.log);
+}
+
+/* Adds the counts of the n_files shard files[] (all the shards of one season), and prints the probabilities */
+void merge_shards(const char** files, int n_files)
+{
+	int i, k;
+	struct shard_header first, h;
+	long long nb_right = 0;
+	long long* proba_right = NULL;
+	char* seen = NULL;
+	for(k=0 ; k<n_files ; k++) {
+		FILE* f = fopen(files[k], "rb");
+		if(!f) {
+			fprintf(stderr, "error : fopen() : %s\n", files[k]);
+			exit(1);
+		}
+		if(fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, SHARD_MAGIC, 8) != 0 || h.version != SHARD_VERSION
+				|| h.n < 2 || h.n > MAX_N || h.n_shards < 1 || h.shard < 0 || h.shard >= h.n_shards) {
+			fprintf(stderr, "error : not a shard file : %s\n", files[k]);
+			exit(1);
+		}
+		if(k == 0) {
+			first = h;
+			proba_right = new_counts(h.n * (h.n-1));
+			if((seen = (char*)calloc(h.n_shards, 1)) == NULL) {
+				fprintf(stderr, "error : calloc()\n");
+				exit(1);
+			}
+		} else if(h.n != first.n || h.n_shards != first.n_shards || h.events != first.events) {
+			fprintf(stderr, "error : %s is not a shard of the same season as %s\n", files[k], files[0]);
+			exit(1);
+		}
+		if(seen[h.shard]++) {
+			fprintf(stderr, "error : shard %d given twice : %s\n", h.shard, files[k]);
+			exit(1);
+		}
+		nb_right += h.nb_right;
+		for(i=0 ; i<h.n * (h.n-1) ; i++) {
+			int64_t count;
+			if(fread(&count, sizeof(count), 1, f) != 1) {
+				fprintf(stderr, "error : shard file too short : %s\n", files[k]);
+				exit(1);
+			}
+			proba_right[i] += count;
+		}
+		fclose(f);
+	}
+	for(i=0 ; i<first.n_shards ; i++)
+		if(!seen[i]) {
+			fprintf(stderr, "error : shard %d of %d is missing\n", i, first.n_shards);
+			exit(1);
+		}
+	print_proba(first.n, first.n-1, nb_right, first.n_arr, proba_right, NAMES(first.nelt), NAMES(first.npos));
+	free(proba_right);
+	free(seen);
+}
+
+/*
+	Benchmarks : each kernel is timed BENCH_RUNS times for n = 7 to 11 (to 12 for count_dp()),
+	and the results are printed in CSV on the standard output, one line by kernel and n :
+		benchmark,n,items,runs,mean_s,stddev_s,items_per_s,ns_per_item
+	where items is the number of arrangements (or permutations) of one run, generated, reviewed or counted,
+	so the engines can be compared directly.
+	The events are applied to all arrangements (as the first event of a season),
+	and season_2 replays test_season_2() with its output thrown away : its items are the arrangements
+	tested by all its reviews (see apply_events()).
+*/
+#define BENCH_RUNS 3 /* Number of runs of each benchmark */
+
+/* Prints the CSV line of the benchmark name for n, with items by run, and the times t[] of the BENCH_RUNS runs */
+void print_bench(const char* name, int n, long long items, const double* t)
+{
+	int i;
+	double mean = 0, var = 0;
+	for(i=0 ; i<BENCH_RUNS ; i++)
+		mean += t[i] / BENCH_RUNS;
+	for(i=0 ; i<BENCH_RUNS ; i++)
+		var += (t[i] - mean) * (t[i] - mean) / (BENCH_RUNS - 1);
+	fprintf(stdout, "%s,%d,%lld,%d,%.6f,%.6f,%.0f,%.3f\n", name, n, items, BENCH_RUNS, mean, sqrt(var),
+		items / mean, 1e9 * mean / items);
+	fflush(stdout);
+}
+
+/* The event of type for the benchmarks with n positions : a truth booth (no), a ceremony (1 match) or a doublon */
+struct event bench_event(int type, int n)
+{
+	struct event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.type = type;
+	ev.pos = n-1;
+	ev.matches = 1;
+	for(int i=0 ; i<n ; i++)
+		ev.a_elt[i] = i < n-1 ? i : -1;
+	return ev;
+}
+
+/* Returns the time of one replay of test_season_2(), with its output thrown away,
+	and sets *tested to the arrangements tested by its reviews
+*/
+double bench_season_2(long long* tested)
+{
+	const long long tested0 = stats_tested;
+	fflush(stdout);
+	fflush(stderr);
+	const int out = dup(1), err = dup(2);
+	const int null = open("/dev/null", O_WRONLY);
+	dup2(null, 1);
+	dup2(null, 2);
+	const double start = now_seconds();
+	test_season_2();
+	const double t = now_seconds() - start;
+	*tested = stats_tested - tested0;
+	fflush(stdout);
+	fflush(stderr);
+	dup2(out, 1);
+	dup2(err, 2);
+	close(null);
+	close(out);
+	close(err);
+	return t;
+}
+
+/* Runs all benchmarks */
+void run_bench()
+{
+	int n, r, k;
+	double t[BENCH_RUNS];
+	const char* ev_names[3] = { "event_booth", "event_ceremony", "event_doublon" };
+	volatile long long sink = 0; /* So the loops are not optimized away */
+	spill_dir = NULL; /* The benchmarks keep the arrangements in memory */
+	fprintf(stdout, "benchmark,n,items,runs,mean_s,stddev_s,items_per_s,ns_per_item\n");
+	for(n=7 ; n<=12 ; n++) {
+		const long long n_arr = n_arrangements(n);
+		const struct event ev = bench_event(EV_CEREMONY, n);
+		long long nb_right, perms = 1, *proba_right = new_counts(n*(n-1));
+		for(k=2 ; k<=n ; k++)
+			perms *= k;
+
+		/* Counting engines */
+		for(r=0 ; r<BENCH_RUNS ; r++) {
+			const double start = now_seconds();
+			count_dp(n, n-1, &ev, 1, &nb_right, proba_right);
+			t[r] = now_seconds() - start;
+		}
+		print_bench("count_dp", n, n_arr, t);
+		if(n_arr > 0x7FFFFFFF) { /* Too long for the others */
+			free(proba_right);
+			continue;
+		}
+		for(r=0 ; r<BENCH_RUNS ; r++) {
+			const double start = now_seconds();
+			count_backtrack(n, n-1, &ev, 1, &nb_right, proba_right);
+			t[r] = now_seconds() - start;
+		}
+		print_bench("count_backtrack", n, n_arr, t);
+		free(proba_right);
+
+		/* Generators */
+		for(r=0 ; r<BENCH_RUNS ; r++) {
+			struct perm_iter it;
+			int* tp;
+			const double start = now_seconds();
+			init_permutation(&it, n);
+			while((tp = next_permutation(&it)) != NULL)
+				sink += tp[0];
+			free_permutation(&it);
+			t[r] = now_seconds() - start;
+		}
+		print_bench("next_permutation", n, perms, t);
+		for(r=0 ; r<BENCH_RUNS ; r++) {
+			struct arr_iter it;
+			int* ta;
+			const double start = now_seconds();
+			init_arrangement(&it, n);
+			while((ta = next_arrangement(&it)) != NULL)
+				sink += ta[0];
+			free_arrangement(&it);
+			t[r] = now_seconds() - start;
+		}
+		print_bench("next_arrangement", n, n_arr, t);
+		for(r=0 ; r<BENCH_RUNS ; r++) { /* The generator of the reviews */
+			struct ranked_gen g;
+			int* ta;
+			const double start = now_seconds();
+			init_ranked(&g, n, 0, n_arr);
+			while((ta = next_ranked(&g)) != NULL)
+				sink += ta[0];
+			t[r] = now_seconds() - start;
+		}
+		print_bench("next_ranked", n, n_arr, t);
+
+		/* Events, on all arrangements */
+		for(k=0 ; k<3 ; k++) {
+			const int type[3] = { EV_COUPLE, EV_CEREMONY, EV_DOUBLON };
+			const struct event e = bench_event(type[k], n);
+			for(r=0 ; r<BENCH_RUNS ; r++) {
+				struct right* right = init_right(n);
+				const double start = now_seconds();
+				apply_event(n, right, &e);
+				t[r] = now_seconds() - start;
+				free_right(right);
+			}
+			print_bench(ev_names[k], n, n_arr, t);
+		}
+
+		/* Counts of each element at each position, on all arrangements */
+		for(r=0 ; r<BENCH_RUNS ; r++) {
+			struct right* right = init_right(n);
+			long long* counts = new_counts(n*(n-1));
+			const double start = now_seconds();
+			run_sweep(n, right->is_right, NULL, counts, NULL);
+			t[r] = now_seconds() - start;
+			free(counts);
+			free_right(right);
+		}
+		print_bench("proba_count", n, n_arr, t);
+	}
 
-	free(is_right);
+	/* A whole season */
+	long long tested = 0;
+	for(r=0 ; r<BENCH_RUNS ; r++)
+		t[r] = bench_season_2(&tested);
+	print_bench("season_2", 11, tested, t);
+	(void)sink;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+	const char* file = NULL; /* The event log */
+	const char* snapshot = NULL; /* The snapshot file */
+	const char* serve = NULL; /* - or the socket for the server mode */
+	const char* scenarios[MAX_SCENARIOS]; /* The event logs of the scenarios */
+	int n_scen = 0;
+	const char* shard_out = NULL; /* The shard file */
+	int shard = -1, n_shards = 0;
+	int print_all = NO, backtrack = NO, sample = NO;
+	for(int i=1 ; i<argc ; i++) {
+		if(strcmp(argv[i], "--threads") == 0 && i+1 < argc && atoi(argv[i+1]) > 0)
+			n_threads = atoi(argv[++i]);
+		else if(strcmp(argv[i], "--budget") == 0 && i+1 < argc && atof(argv[i+1]) > 0)
+			time_budget = atof(argv[++i]);
+		else if(strcmp(argv[i], "--all") == 0)
+			print_all = YES;
+		else if(strcmp(argv[i], "--bench") == 0) {
+			run_bench();
+			return 0;
+		}
+		else if(strcmp(argv[i], "--backtrack") == 0)
+			backtrack = COUNT_BACKTRACK;
+		else if(strcmp(argv[i], "--dp") == 0)
+			backtrack = COUNT_DP;
+		else if(strcmp(argv[i], "--sample") == 0)
+			sample = YES;
+		else if(strcmp(argv[i], "--precision") == 0 && i+1 < argc && atof(argv[i+1]) > 0)
+			sample_precision = atof(argv[++i]);
+		else if(strcmp(argv[i], "--stats") == 0 && i+1 < argc) {
+			const char* name = argv[++i];
+			stats_file = strcmp(name, "-") == 0 ? stderr : fopen(name, "w");
+			if(!stats_file) {
+				fprintf(stderr, "error : fopen() : %s\n", name);
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--progress") == 0)
+			show_progress = YES;
+		else if(strcmp(argv[i], "--snapshot") == 0 && i+1 < argc)
+			snapshot = argv[++i];
+		else if(strcmp(argv[i], "--spill") == 0 && i+1 < argc)
+			spill_dir = argv[++i];
+		else if(strcmp(argv[i], "--scenario") == 0 && i+1 < argc && n_scen < MAX_SCENARIOS)
+			scenarios[n_scen++] = argv[++i];
+		else if(strcmp(argv[i], "--shard") == 0 && i+1 < argc && sscanf(argv[i+1], "%d/%d", &shard, &n_shards) == 2
+				&& shard >= 0 && shard < n_shards) {
+			i++;
+		}
+		else if(strcmp(argv[i], "--out") == 0 && i+1 < argc)
+			shard_out = argv[++i];
+		else if(strcmp(argv[i], "--merge") == 0 && i+1 < argc) {
+			merge_shards((const char**)argv + i+1, argc - (i+1));
+			return 0;
+		}
+		else if(strcmp(argv[i], "--serve") == 0)
+			serve = "-";
+		else if(strcmp(argv[i], "--socket") == 0 && i+1 < argc)
+			serve = argv[++i];
+		else if(file == NULL && (argv[i][0] != '-' || strcmp(argv[i], "-") == 0))
+			file = argv[i];
+		else {
+			fprintf(stderr, "usage : %s [--bench] [--threads N] [--budget S] [--stats FILE] [--progress] [--all] [--backtrack | --dp | --sample [--precision P]] [--snapshot FILE | --spill DIR] [--scenario EVENT_LOG ...] [--shard I/N --out FILE] [--merge SHARD_FILE ...] [--serve | --socket PATH] [EVENT_LOG | -]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(snapshot != NULL && (backtrack || sample || file == NULL)) {
+		fprintf(stderr, "error : --snapshot needs an event log, and no --backtrack, --dp or --sample\n");
+		return 1;
+	}
+	if(snapshot != NULL && spill_dir != NULL) {
+		fprintf(stderr, "error : --snapshot keeps the arrangements in memory, not with --spill\n");
+		return 1;
+	}
+	if(serve != NULL && file != NULL && strcmp(file, "-") == 0 && strcmp(serve, "-") == 0) {
+		fprintf(stderr, "error : --serve reads the commands from the standard input, not the event log\n");
+		return 1;
+	}
+	if(n_shards > 0) { /* One shard of the review */
+		if(file == NULL || strcmp(file, "-") == 0 || shard_out == NULL || serve != NULL || snapshot != NULL || spill_dir != NULL
+				|| backtrack || sample || n_scen > 0) {
+			fprintf(stderr, "error : --shard needs an event log file and --out, with no other mode\n");
+			return 1;
+		}
+		run_shard(file, shard, n_shards, shard_out);
+		return 0;
+	}
+	if(n_scen > 0) { /* The scenarios are reviewed together */
+		if(file != NULL || serve != NULL || snapshot != NULL || spill_dir != NULL || backtrack || sample) {
+			fprintf(stderr, "error : --scenario reviews all arrangements in memory, with no other event log or mode\n");
+			return 1;
+		}
+		run_scenarios(scenarios, n_scen);
+		return 0;
+	}
+	if(serve != NULL && file == NULL) { /* The season comes from the commands */
+		run_event_log(NULL, print_all, backtrack, sample, NULL, serve);
+		return 0;
+	}
+
+	if(file != NULL) { /* Read the season from the event log (- for the standard input) */
+		FILE* f = strcmp(file, "-") == 0 ? stdin : fopen(file, "r");
+		if(!f) {
+			fprintf(stderr, "error : fopen() : %s\n", file);
+			return 1;
+		}
+		run_event_log(f, print_all, backtrack, sample, snapshot, serve);
+		if(f != stdin)
+			fclose(f);
+		return 0;
+	}
+
 	//test_permutation();
 	//test_arrangement();
+	//test_rank();
 	//test_eleven();
 	//test_small();
+	//test_small_batch();
+	//test_backtrack();
+	//test_dp();
+	//test_sample();
 	//test_season_2();
 	test_season_3();
 